@@ -39,6 +39,7 @@ file_def_t::file_def_t(wxWindow* parent, model_t const& model, chr_file_t const&
     wxButton* rename_button = new wxButton(this, wxID_ANY, "Rename");
     wxButton* reid_button = new wxButton(this, wxID_ANY, "Set Id");
     wxButton* open_button = new wxButton(this, wxID_ANY, "Set Path");
+    wxButton* compact_button = new wxButton(this, wxID_ANY, "Compact");
     wxButton* delete_button = new wxButton(this, wxID_ANY, "Delete");
 
     row_sizer->Add(name_label, wxSizerFlags().Left().Border().Center());
@@ -53,12 +54,14 @@ file_def_t::file_def_t(wxWindow* parent, model_t const& model, chr_file_t const&
     row_sizer->Add(filename, wxSizerFlags().Left().Border().Center());
     row_sizer->AddSpacer(16);
     row_sizer->Add(open_button, wxSizerFlags().Left().Border().Center());
+    row_sizer->Add(compact_button, wxSizerFlags().Left().Border().Center());
     row_sizer->Add(delete_button, wxSizerFlags().Left().Border().Center());
 
     rename_button->Bind(wxEVT_COMMAND_BUTTON_CLICKED, &file_def_t::on_rename, this);
     reid_button->Bind(wxEVT_COMMAND_BUTTON_CLICKED, &file_def_t::on_reid, this);
     delete_button->Bind(wxEVT_COMMAND_BUTTON_CLICKED, &file_def_t::on_delete, this);
     open_button->Bind(wxEVT_COMMAND_BUTTON_CLICKED, &file_def_t::on_open, this);
+    compact_button->Bind(wxEVT_COMMAND_BUTTON_CLICKED, &file_def_t::on_compact, this);
 
     SetSizerAndFit(row_sizer);
 }
@@ -90,6 +93,15 @@ void file_def_t::on_open(wxCommandEvent& event)
     }
 }
 
+void file_def_t::on_compact(wxCommandEvent& event)
+{
+    if(static_cast<chr_editor_t*>(GetParent())->on_compact(index))
+    {
+        filename->SetValue(file.path.string());
+        Refresh();
+    }
+}
+
 void file_def_t::on_rename(wxCommandEvent& event)
 { 
     wxTextEntryDialog dialog(
@@ -189,9 +201,7 @@ void chr_editor_t::on_open_collision(wxCommandEvent& event)
         model.collision_path = filename;
         try
         {
-            auto bm = load_collision_file(filename, model.collision_scale());
-            model.collision_bitmaps = std::move(bm.first);
-            model.collision_wx_bitmaps = std::move(bm.second);
+            model.load_collisions();
         }
         catch(...)
         {}
@@ -305,9 +315,12 @@ void chr_editor_t::on_reid(unsigned index, unsigned new_id)
     model.chr_files[index].id = new_id;
 
     for(auto& level : model.levels)
+    {
         for(std::uint32_t& t : level->chr_layer.tiles)
             if(chr_id(t) == old_id)
                 t = with_chr_id(t, new_id);
+        level->chr_layer.touch_all();
+    }
 
     model.modify();
 }
@@ -315,10 +328,107 @@ void chr_editor_t::on_reid(unsigned index, unsigned new_id)
 void chr_editor_t::on_open(unsigned index, std::string path)
 {
     model.chr_files[index].path = path;
-    model.chr_files[index].load();
+    model.chr_files[index].load_async();
     model.modify();
 }
 
+bool chr_editor_t::on_compact(unsigned index)
+{
+    chr_file_t& file = model.chr_files[index];
+
+    std::size_t const size = std::min(file.indices.size() * 16, file.chr.size());
+    if(size == 0)
+    {
+        wxMessageBox(wxT("No CHR is loaded."), wxT("Error"), wxICON_ERROR);
+        return false;
+    }
+
+    // Level tiles have no flip bits, so flipped copies can only be merged when no level uses the CHR.
+    bool used = false;
+    for(auto const& level : model.levels)
+        for(std::uint32_t t : level->chr_layer.tiles)
+            used |= chr_id(t) == file.id;
+
+    bool flips = false;
+    if(!used)
+    {
+        wxMessageDialog dialog(this, "No level uses this CHR.\nAlso merge tiles that are flipped copies of others?", 
+                               "Compact", wxYES_NO | wxCANCEL | wxICON_QUESTION);
+        int const answer = dialog.ShowModal();
+        if(answer == wxID_CANCEL)
+            return false;
+        flips = answer == wxID_YES;
+    }
+
+    chr_dedup_t const dedup = dedup_chr(file.chr.data(), size, flips);
+    unsigned const old_count = size / 16;
+    unsigned const new_count = dedup.chr.size() / 16;
+
+    if(new_count == old_count)
+    {
+        wxMessageBox(wxT("Every tile is already unique."), wxT("Compact"), wxICON_INFORMATION);
+        return false;
+    }
+
+    wxString text;
+    text << new_count << " of " << old_count << " tiles are unique.\n";
+    text << "Save the compacted CHR and remap every level using it?\nThis cannot be undone.";
+
+    wxMessageDialog dialog(this, text, "Compact", wxOK | wxCANCEL | wxICON_WARNING);
+    if(dialog.ShowModal() != wxID_OK)
+        return false;
+
+    wxFileDialog save_dialog(
+        this, _("Save compacted CHR"), wxEmptyString, wxEmptyString, 
+        _("CHR files (*.chr)|*.chr"),
+        wxFD_SAVE | wxFD_OVERWRITE_PROMPT, wxDefaultPosition);
+
+    if(!file.path.empty())
+    {
+        std::filesystem::path suggested = file.path;
+        suggested.replace_filename(file.path.stem().string() + "_compact.chr");
+        save_dialog.SetPath(suggested.string());
+    }
+    else if(!model.project_path.empty())
+        save_dialog.SetPath(model.project_path.string());
+
+    if(save_dialog.ShowModal() != wxID_OK)
+        return false;
+
+    std::string const path = save_dialog.GetPath().ToStdString();
+
+    {
+        FILE* fp = std::fopen(path.c_str(), "wb");
+        if(!fp)
+        {
+            wxMessageBox(wxT("Unable to write file."), wxT("Error"), wxICON_ERROR);
+            return false;
+        }
+        auto guard = make_scope_guard([&]{ std::fclose(fp); });
+        std::fwrite(dedup.chr.data(), dedup.chr.size(), 1, fp);
+    }
+
+    auto const remap = [&](std::uint32_t& t)
+    {
+        if(chr_id(t) == file.id && tile_tile(t) < dedup.remap.size())
+            t = (t & ~std::uint32_t(CHR_REMAP_INDEX)) | (dedup.remap[tile_tile(t)] & CHR_REMAP_INDEX);
+    };
+
+    for(auto& level : model.levels)
+    {
+        for(std::uint32_t& t : level->chr_layer.tiles)
+            remap(t);
+        level->chr_layer.touch_all();
+    }
+
+    // Undo records hold old indices too:
+    if(remap_level_tiles)
+        remap_level_tiles(remap);
+
+    on_open(index, path);
+    return true;
+}
+
 void chr_editor_t::on_change_scale(wxSpinEvent& event)
 {
     int const w = event.GetPosition(); 
@@ -326,9 +436,7 @@ void chr_editor_t::on_change_scale(wxSpinEvent& event)
 
     try
     {
-        auto bm = load_collision_file(model.collision_path.string(), model.collision_scale());
-        model.collision_bitmaps = std::move(bm.first);
-        model.collision_wx_bitmaps = std::move(bm.second);
+        model.rescale_collisions();
     }
     catch(...)
     {}
@@ -2,6 +2,7 @@
 #define CHR_HPP
 
 #include <cassert>
+#include <functional>
 #include <ranges>
 
 #include <wx/wx.h>
@@ -29,6 +30,7 @@ public:
     void on_delete(wxCommandEvent& event);
     void on_rename(wxCommandEvent& event);
     void on_reid(wxCommandEvent& event);
+    void on_compact(wxCommandEvent& event);
 
     unsigned index = 0;
     unsigned id = 0;
@@ -50,11 +52,15 @@ public:
     void on_rename(unsigned index, std::string str);
     void on_reid(unsigned index, unsigned new_id);
     void on_open(unsigned index, std::string path);
+    bool on_compact(unsigned index);
     void on_open_collision(wxCommandEvent& event);
     void on_change_scale(wxSpinEvent& event);
 
     void load();
 
+    // Set by the owner to rewrite the level tiles that it keeps, like undo histories.
+    std::function<void(std::function<void(std::uint32_t&)> const&)> remap_level_tiles;
+
 private:
     void new_file(chr_file_t const& file);
 
@@ -0,0 +1,182 @@
+#include "compose.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define COMPOSE_SSSE3
+#endif
+
+#include "model.hpp"
+
+attr_lut_t make_attr_lut(std::uint8_t const* palette)
+{
+    attr_lut_t lut;
+    for(unsigned j = 0; j < 4; ++j)
+    for(unsigned entry = 0; entry < 4; ++entry)
+        lut[j][entry] = nes_colors[palette[entry + (j*4)] % 64];
+    return lut;
+}
+
+compose_tile_t bad_compose_tile()
+{
+    // Decoded once from 'bad_image_xpm':
+    struct bad_t
+    {
+        std::array<std::uint8_t, 64> pixels;
+        std::array<rgb_t, 4> colors;
+    };
+
+    static bad_t const bad = []
+    {
+        bad_t ret = {};
+        char symbols[4];
+        for(unsigned i = 0; i < 4; ++i)
+        {
+            char const* line = bad_image_xpm[i + 1]; // Like " \tc #390000"
+            symbols[i] = line[0];
+            unsigned long const hex = std::strtoul(line + 5, nullptr, 16);
+            ret.colors[i] = { std::uint8_t(hex >> 16), std::uint8_t(hex >> 8), std::uint8_t(hex) };
+        }
+
+        for(unsigned y = 0; y < 8; ++y)
+        for(unsigned x = 0; x < 8; ++x)
+            ret.pixels[x + y*8] = std::find(symbols, symbols + 4, bad_image_xpm[y + 5][x]) - symbols;
+        return ret;
+    }();
+
+    return { bad.pixels.data(), &bad.colors };
+}
+
+#ifdef COMPOSE_SSSE3
+namespace
+{
+    constexpr int MAX_SHUFFLE_ZOOM = 16;
+
+    // For each output byte of a zoomed tile row, the source pixel and color channel it comes from.
+    struct row_shuffle_t
+    {
+        alignas(16) std::uint8_t pick[8 * 3 * MAX_SHUFFLE_ZOOM];
+        alignas(16) std::uint8_t channel[8 * 3 * MAX_SHUFFLE_ZOOM];
+        int bytes;
+    };
+
+    row_shuffle_t const& row_shuffle(int zoom)
+    {
+        static auto const shuffles = []
+        {
+            std::array<row_shuffle_t, MAX_SHUFFLE_ZOOM + 1> ret = {};
+            for(int z = 1; z <= MAX_SHUFFLE_ZOOM; ++z)
+            {
+                ret[z].bytes = 8 * 3 * z;
+                for(int j = 0; j < ret[z].bytes; ++j)
+                {
+                    ret[z].pick[j] = (j / 3) / z;
+                    ret[z].channel[j] = j % 3;
+                }
+            }
+            return ret;
+        }();
+        return shuffles[zoom];
+    }
+
+    // Writes one zoomed tile row, 16 bytes at a time.
+    // The 4 colors fit in one register, so 'pshufb' does the palette lookup and the pixel replication together.
+    __attribute__((target("ssse3")))
+    void expand_row_ssse3(rgb_t* dst, std::uint8_t const* src, std::array<rgb_t, 4> const& colors, row_shuffle_t const& shuffle)
+    {
+        std::uint8_t lut[16] = {};
+        std::memcpy(lut, colors.data(), sizeof(colors));
+        __m128i const palette = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lut));
+
+        __m128i const indices = _mm_and_si128(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src)), _mm_set1_epi8(0b11));
+        __m128i const offsets = _mm_add_epi8(indices, _mm_add_epi8(indices, indices)); // Byte offsets into 'palette'.
+
+        std::uint8_t* const out = reinterpret_cast<std::uint8_t*>(dst);
+        for(int i = 0; i < shuffle.bytes; i += 16)
+        {
+            __m128i const pick = _mm_load_si128(reinterpret_cast<__m128i const*>(shuffle.pick + i));
+            __m128i const channel = _mm_load_si128(reinterpret_cast<__m128i const*>(shuffle.channel + i));
+            __m128i const bytes = _mm_shuffle_epi8(palette, _mm_add_epi8(_mm_shuffle_epi8(offsets, pick), channel));
+
+            if(i + 16 <= shuffle.bytes)
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+            else // Odd zooms end on a half register.
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), bytes);
+        }
+    }
+
+    bool has_ssse3()
+    {
+        static bool const ret = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+        return ret;
+    }
+}
+#endif
+
+void compose_tile_row(compose_target_t const& target, coord_t at, int zoom, compose_tile_t const* tiles, unsigned count)
+{
+    int const span = 8 * zoom;
+    int const x0 = std::max(0, at.x);
+    int const y0 = std::max(0, at.y);
+    int const x1 = std::min(target.dimen.w, at.x + int(count) * span);
+    int const y1 = std::min(target.dimen.h, at.y + span);
+    if(x0 >= x1 || y0 >= y1)
+        return;
+
+#ifdef COMPOSE_SSSE3
+    row_shuffle_t const* const shuffle = has_ssse3() && zoom <= MAX_SHUFFLE_ZOOM ? &row_shuffle(zoom) : nullptr;
+#endif
+
+    int prev_sy = -1;
+    for(int y = y0; y < y1; ++y)
+    {
+        rgb_t* const out = target.pixels + y * target.stride;
+        int const sy = (y - at.y) / zoom;
+
+        // Zoomed rows repeat the one above:
+        if(sy == prev_sy)
+        {
+            std::memcpy(out + x0, out - target.stride + x0, (x1 - x0) * sizeof(rgb_t));
+            continue;
+        }
+        prev_sy = sy;
+
+        for(unsigned i = 0; i < count; ++i)
+        {
+            int const tx = at.x + int(i) * span;
+            if(tx + span <= x0 || tx >= x1)
+                continue;
+
+            std::uint8_t const* const src = tiles[i].pixels + sy * 8;
+            std::array<rgb_t, 4> const& colors = *tiles[i].colors;
+
+            if(tx >= x0 && tx + span <= x1)
+            {
+                rgb_t* const dst = out + tx;
+#ifdef COMPOSE_SSSE3
+                if(shuffle)
+                    expand_row_ssse3(dst, src, colors, *shuffle);
+                else
+#endif
+                if(zoom == 1)
+                {
+                    for(unsigned k = 0; k < 8; ++k)
+                        dst[k] = colors[src[k] & 0b11];
+                }
+                else
+                {
+                    for(unsigned k = 0; k < 8; ++k)
+                        std::fill_n(dst + k * zoom, zoom, colors[src[k] & 0b11]);
+                }
+            }
+            else // Clipped at an edge.
+            {
+                int const end = std::min(tx + span, x1);
+                for(int x = std::max(tx, x0); x < end; ++x)
+                    out[x] = colors[src[(x - tx) / zoom] & 0b11];
+            }
+        }
+    }
+}
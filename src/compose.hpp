@@ -0,0 +1,115 @@
+#ifndef COMPOSE_HPP
+#define COMPOSE_HPP
+
+// Software rendering of tile grids straight into an RGB buffer.
+// Much faster than one 'DrawBitmap' per 8x8 tile, as there's no per-call overhead.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "2d/geometry.hpp"
+
+#include "nes_colors.hpp"
+
+using namespace i2d;
+
+using attr_lut_t = std::array<std::array<rgb_t, 4>, 4>;
+
+// The 4 colors of each attribute, from a 16 entry palette.
+attr_lut_t make_attr_lut(std::uint8_t const* palette);
+
+struct compose_tile_t
+{
+    std::uint8_t const* pixels; // 64 color indices, like 'chr_planes_t::tile'.
+    std::array<rgb_t, 4> const* colors;
+};
+
+// Used for tiles with no valid CHR.
+compose_tile_t bad_compose_tile();
+
+struct compose_target_t
+{
+    rgb_t* pixels;
+    int stride; // In pixels.
+    dimen_t dimen;
+};
+
+// Draws a horizontal run of 'count' tiles, with the first's top-left at 'at'.
+// Each tile pixel becomes a 'zoom' by 'zoom' square. Anything outside the target is clipped.
+void compose_tile_row(compose_target_t const& target, coord_t at, int zoom, compose_tile_t const* tiles, unsigned count);
+
+// Draws a 'tiles' sized grid with its top-left at 'origin'.
+// 'tile_at' maps a grid coordinate to a 'compose_tile_t', and is only called for tiles that overlap the target.
+template<typename Fn>
+void compose_tiles(compose_target_t const& target, coord_t origin, dimen_t tiles, int zoom, Fn const& tile_at)
+{
+    int const span = 8 * zoom;
+    auto const floor_div = [](int a, int b) { return a >= 0 ? a / b : (a - b + 1) / b; };
+
+    int const x0 = std::max(0, floor_div(-origin.x, span));
+    int const y0 = std::max(0, floor_div(-origin.y, span));
+    int const x1 = std::min(tiles.w, floor_div(target.dimen.w - origin.x + span - 1, span));
+    int const y1 = std::min(tiles.h, floor_div(target.dimen.h - origin.y + span - 1, span));
+    if(x0 >= x1 || y0 >= y1)
+        return;
+
+    std::vector<compose_tile_t> row(x1 - x0);
+    for(int y = y0; y < y1; ++y)
+    {
+        for(int x = x0; x < x1; ++x)
+            row[x - x0] = tile_at(coord_t{ x, y });
+        compose_tile_row(target, { origin.x + x0 * span, origin.y + y * span }, zoom, row.data(), row.size());
+    }
+}
+
+// The part of 'a' inside 'b'.
+inline rect_t overlap_rect(rect_t a, rect_t b)
+{
+    rect_t r = crop(rect_t{ coord_t{ a.c.x - b.c.x, a.c.y - b.c.y }, a.d }, b.d);
+    if(r)
+        r.c = { r.c.x + b.c.x, r.c.y + b.c.y };
+    return r;
+}
+
+// Whether 'inner' is entirely inside 'outer'. Empty rects always are.
+inline bool rect_covers(rect_t outer, rect_t inner)
+{
+    return !inner || (inner.c.x >= outer.c.x && inner.c.y >= outer.c.y && inner.e().x <= outer.e().x && inner.e().y <= outer.e().y);
+}
+
+// A composed area of a tile grid, in zoomed pixels from the grid's top-left.
+// Built on a worker, then kept by the view to copy from.
+struct compose_frame_t
+{
+    std::uint64_t key = 0; // Changes when every tile may look different.
+    std::uint64_t generation = 0; // Tile edits up to this generation are included.
+    rect_t rect = {};
+    std::vector<rgb_t> pixels;
+
+    bool covers(rect_t r) const { return rect_covers(rect, r); }
+
+    // The pixels of 'r', which must be inside 'rect'.
+    compose_target_t target(rect_t r)
+    {
+        return { pixels.data() + (r.c.x - rect.c.x) + (r.c.y - rect.c.y) * rect.d.w, rect.d.w, r.d };
+    }
+
+    // Copies what the frame has of 'r' into 'out', which holds 'r' with a row length of 'stride'.
+    void copy_to(rect_t r, rgb_t* out, int stride) const
+    {
+        rect_t const o = overlap_rect(r, rect);
+        if(!o)
+            return;
+        for(int y = o.c.y; y < o.e().y; ++y)
+        {
+            std::memcpy(out + (o.c.x - r.c.x) + (y - r.c.y) * stride, 
+                        pixels.data() + (o.c.x - rect.c.x) + (y - rect.c.y) * rect.d.w, 
+                        o.d.w * sizeof(rgb_t));
+        }
+    }
+};
+
+#endif
@@ -1,8 +1,13 @@
 #include "convert.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
 #include "lodepng/lodepng.h"
 
 #include "model.hpp"
+#include "worker.hpp"
 
 std::vector<std::uint8_t> read_binary_file(char const* filename)
 {
@@ -24,76 +29,112 @@ std::vector<std::uint8_t> read_binary_file(char const* filename)
     return data;
 }
 
-std::vector<attr_bitmaps_t> chr_to_bitmaps(std::uint8_t const* data, std::size_t size, std::uint8_t const* palette, 
-                                           std::vector<std::uint16_t> const& indices)
+chr_planes_t chr_to_planes(std::uint8_t const* data, std::size_t size, std::vector<std::uint16_t> const& indices)
 {
-    std::vector<attr_bitmaps_t> ret;
-
-    //size = std::min<std::size_t>(size, 16*256);
+    std::size_t const num_tiles = size / 16;
 
-    wxImage bad_image(bad_image_xpm);
+    chr_planes_t ret;
+    ret.pixels.resize(num_tiles * 64);
+    ret.bad.resize(num_tiles);
 
-    for(unsigned i = 0; i < size; i += 16)
+    for(std::size_t j = 0; j < num_tiles; ++j)
     {
-        unsigned j = i / 16;
-        if(j >= indices.size() || (j != 0 && indices[j] == indices[j-1]))
+        ret.bad[j] = j >= indices.size() || (j != 0 && indices[j] == indices[j-1]);
+
+        std::uint8_t const* plane0 = data + j * 16;
+        std::uint8_t const* plane1 = data + j * 16 + 8;
+        std::uint8_t* out = &ret.pixels[j * 64];
+
+        for(unsigned y = 0; y < 8; ++y)
+        for(unsigned x = 0; x < 8; ++x)
         {
-            ret.push_back({{
-                bad_image,
-                bad_image,
-                bad_image,
-                bad_image,
-            }});
+            unsigned const rx = 7 - x;
+            out[y*8+x] = ((plane0[y] >> rx) & 1) | (((plane1[y] >> rx) << 1) & 0b10);
+        }
+    }
+
+    return ret;
+}
+
+std::vector<tile_rgb_t> planes_to_rgb(chr_planes_t const& planes, std::uint8_t const* palette)
+{
+    attr_lut_t const lut = make_attr_lut(palette);
+
+    std::vector<tile_rgb_t> ret(planes.size());
+
+    for(std::size_t i = 0; i < planes.size(); ++i)
+    {
+        tile_rgb_t& tile = ret[i];
+        if(planes.bad[i])
             continue;
+
+        tile.bad = false;
+
+        std::uint8_t const* pixels = planes.tile(i);
+        for(unsigned j = 0; j < 4; ++j)
+        {
+            rgb_t* out = tile.rgb[j].data();
+            for(unsigned k = 0; k < 8*8; ++k)
+                out[k] = lut[j][pixels[k] & 0b11];
         }
+    }
 
-        std::array<std::array<rgb_t, 8*8>, 4> rgb;
+    return ret;
+}
 
-        std::uint8_t const* plane0 = data + i;
-        std::uint8_t const* plane1 = data + i + 8;
+std::vector<std::array<rgb_t, 4>> average_rgb(std::vector<tile_rgb_t> const& tiles)
+{
+    std::vector<std::array<rgb_t, 4>> ret(tiles.size());
 
-        for(unsigned y = 0; y < 8; ++y)
-        for(unsigned x = 0; x < 8; ++x)
+    for(std::size_t i = 0; i < tiles.size(); ++i)
+    {
+        if(tiles[i].bad)
         {
-            unsigned const rx = 7 - x;
-            unsigned const entry = ((plane0[y] >> rx) & 1) | (((plane1[y] >> rx) << 1) & 0b10);
-            assert(entry < 4);
+            ret[i].fill(BAD_TILE_RGB);
+            continue;
+        }
 
-            for(unsigned j = 0; j < 4; ++j)
+        for(unsigned j = 0; j < 4; ++j)
+        {
+            unsigned r = 0, g = 0, b = 0;
+            for(rgb_t const& c : tiles[i].rgb[j])
             {
-                std::uint8_t const color = palette[entry + (j*4)] % 64;
-                rgb[j][y*8+x] = nes_colors[color];
+                r += c.r;
+                g += c.g;
+                b += c.b;
             }
+            ret[i][j] = { std::uint8_t(r / 64), std::uint8_t(g / 64), std::uint8_t(b / 64) };
         }
-
-        ret.push_back({{
-            wxImage(8, 8, reinterpret_cast<unsigned char*>(rgb[0].data()), true),
-            wxImage(8, 8, reinterpret_cast<unsigned char*>(rgb[1].data()), true),
-            wxImage(8, 8, reinterpret_cast<unsigned char*>(rgb[2].data()), true),
-            wxImage(8, 8, reinterpret_cast<unsigned char*>(rgb[3].data()), true),
-        }});
     }
 
     return ret;
 }
 
-std::pair<std::vector<bitmap_t>, std::vector<wxBitmap>> load_collision_file(wxString const& string, unsigned scale)
+wxImage load_collision_image(wxString const& string)
 {
-    if(string.IsEmpty() || scale == 0)
+    if(string.IsEmpty())
         return {};
 
-    std::pair<std::vector<bitmap_t>, std::vector<wxBitmap>> ret;
-
     wxLogNull go_away;
-    wxImage base(string);
-    if(!base.IsOk())
+    return wxImage(string);
+}
+
+std::pair<std::vector<bitmap_t>, std::vector<wxBitmap>> slice_collision_image(wxImage const& base, unsigned scale)
+{
+    if(!base.IsOk() || scale == 0)
         return {};
 
+    std::pair<std::vector<bitmap_t>, std::vector<wxBitmap>> ret;
+    ret.first.reserve(4 * 64);
+    ret.second.reserve(4 * 64);
+
+    // Pad (or crop) to the full tileset once, then cut each tile out of that:
+    int const s = 8 * scale;
+    wxImage const atlas = base.Size({ 4 * s, 64 * s }, { 0, 0 }, 255, 0, 255);
+
     for(coord_t c : dimen_range({4, 64}))
     {
-        wxImage tile = base.Copy();
-        unsigned const s = 8 * scale;
-        tile.Resize({ s, s }, { c.x * -s, c.y * -s }, 255, 0, 255);
+        wxImage const tile = atlas.GetSubImage({ c.x * s, c.y * s, s, s });
 #ifdef GC_RENDER
         ret.first.emplace_back(get_renderer()->CreateBitmapFromImage(tile));
 #else
@@ -105,54 +146,102 @@ std::pair<std::vector<bitmap_t>, std::vector<wxBitmap>> load_collision_file(wxSt
     return ret;
 }
 
-static std::uint8_t map_grey_alpha(std::uint8_t grey, std::uint8_t alpha, std::uint8_t& transparent)
-{
-    transparent = alpha < 128;
-    return grey >> 6;
-}
-
 namespace
 {
+    // Maps palette entries to 2-bit CHR values.
+    // Opaque entries are numbered in order; translucent ones become transparent 0s.
     class palette_map_t
     {
     public:
-        palette_map_t(unsigned char* palette, unsigned num_colors)
+        palette_map_t(unsigned char const* palette, unsigned num_colors)
         {
-            for(unsigned i = 0; i < num_colors; ++i) 
+            map.fill(0);
+            alpha.fill(true);
+
+            unsigned n = 0;
+            for(unsigned i = 0; i < num_colors && i < 256; ++i) 
             {
-                std::uint8_t const a = palette[4 * i + 3];
-                if(a >= 128)
-                    map.push_back(i);
+                if(palette[4 * i + 3] >= 128)
+                {
+                    map[i] = n++;
+                    alpha[i] = false;
+                }
             }
         }
 
-        std::uint8_t lookup(std::uint8_t palette) const 
-        { 
-            for(unsigned i = 0; i < map.size(); i += 1)
-                if(palette == map[i])
-                    return i;
-            return 0;
-        }
+        std::uint8_t lookup(std::uint8_t palette) const { return map[palette]; }
+        bool is_alpha(std::uint8_t palette) const { return alpha[palette]; }
+
+    private:
+        std::array<std::uint8_t, 256> map;
+        std::array<bool, 256> alpha;
+    };
+
+    struct chr_pixel_t
+    {
+        std::uint8_t value;
+        bool transparent;
+    };
+
+    // Packs decoded pixels into CHR in a single pass per tile.
+    // 'pixel(i)' returns the CHR value and transparency of the i-th pixel.
+    // Tile rows are independent, so they're split across the worker pool.
+    template<typename Fn>
+    chr_patterns_t pack_chr(unsigned width, unsigned height, Fn const& pixel)
+    {
+        unsigned const tiles_w = width / 8;
+        unsigned const tiles_h = height / 8;
+        unsigned const num_tiles = tiles_w * tiles_h;
+
+        std::vector<std::uint8_t> result(num_tiles * 16);
+        std::vector<std::uint8_t> empty(num_tiles);
 
-        std::uint8_t is_alpha(std::uint8_t palette) const 
+        parallel_for(0, tiles_h, [&](unsigned ty)
+        {
+            for(unsigned tx = 0; tx < tiles_w; ++tx)
+            {
+                unsigned const t = tx + ty * tiles_w;
+                std::uint8_t* out = &result[t * 16];
+                unsigned num_transparent = 0;
+
+                for(unsigned y = 0; y < 8; ++y)
+                {
+                    std::size_t const row = std::size_t(ty * 8 + y) * width + tx * 8;
+                    std::uint8_t lo = 0;
+                    std::uint8_t hi = 0;
+                    for(unsigned x = 0; x < 8; ++x)
+                    {
+                        chr_pixel_t const p = pixel(row + x);
+                        lo |= (p.value & 1) << (7-x);
+                        hi |= ((p.value >> 1) & 1) << (7-x);
+                        num_transparent += p.transparent;
+                    }
+                    out[y] = lo;
+                    out[y + 8] = hi;
+                }
+
+                empty[t] = num_transparent == 64;
+            }
+        });
+
+        // Fully transparent tiles share the index of the tile before them.
+        std::vector<std::uint16_t> indices(num_tiles);
+        std::uint16_t index = 0;
+        for(unsigned t = 0; t < num_tiles; ++t)
         {
-            for(unsigned i = 0; i < map.size(); i += 1)
-                if(palette == map[i])
-                    return false;
-            return true;
+            if(!empty[t])
+                index += 1;
+            indices[t] = index;
         }
 
-    private:
-        std::vector<std::uint8_t> map;
-    };
+        return { std::move(result), std::move(indices) };
+    }
 }
 
-
 chr_patterns_t png_to_chr(std::uint8_t const* png, std::size_t size)
 {
     unsigned width, height;
     std::vector<std::uint8_t> image; //the raw pixels
-    std::vector<std::uint8_t> transparent;
     lodepng::State state;
     unsigned error;
 
@@ -172,89 +261,115 @@ chr_patterns_t png_to_chr(std::uint8_t const* png, std::size_t size)
             if((error = lodepng::decode(image, width, height, state, png, size)))
                 goto fail;
             LodePNGColorMode& color = state.info_png.color;
-            palette_map_t map(color.palette, color.palettesize);
-            unsigned const n = width * height;
-            transparent.resize(n);
-            for(unsigned i = 0; i < n; i += 1)
+            palette_map_t const map(color.palette, color.palettesize);
+            return pack_chr(width, height, [&](std::size_t i)
             {
-                transparent[i] = map.is_alpha(image[i]);
-                image[i] = map.lookup(image[i]);
-            }
+                return chr_pixel_t{ map.lookup(image[i]), map.is_alpha(image[i]) };
+            });
         }
-        break;
 
     case LCT_GREY:
     case LCT_RGB:
         state.info_raw.colortype = LCT_GREY;
         if((error = lodepng::decode(image, width, height, state, png, size)))
             goto fail;
-        transparent.resize(width * height, 0);
-        for(std::uint8_t& c : image)
-            c >>= 6;
-        break;
+        return pack_chr(width, height, [&](std::size_t i)
+        {
+            return chr_pixel_t{ std::uint8_t(image[i] >> 6), false };
+        });
 
     default:
         state.info_raw.colortype = LCT_GREY_ALPHA;
         if((error = lodepng::decode(image, width, height, state, png, size)))
             goto fail;
-        assert(image.size() == width * height * 2);
-        unsigned const n = width * height;
-        transparent.resize(n);
-        for(unsigned i = 0; i < n; ++i)
-            image[i] = map_grey_alpha(image[i*2], image[i*2 + 1], transparent[i]);
-        image.resize(n);
-        break;
+        assert(image.size() == std::size_t(width) * height * 2);
+        return pack_chr(width, height, [&](std::size_t i)
+        {
+            return chr_pixel_t{ std::uint8_t(image[i*2] >> 6), image[i*2 + 1] < 128 };
+        });
     }
 
-    // Now convert to CHR
-    {
-        std::vector<std::uint8_t> result;
-        result.reserve(image.size() / 4);
+fail:
+    throw std::runtime_error(std::string("png decoder error: ") + lodepng_error_text(error));
+}
 
-        std::vector<std::uint16_t> indices;
-        indices.reserve(image.size() / 64);
-        std::uint16_t index = 0;
+namespace
+{
+    using pattern_t = std::array<std::uint8_t, 16>;
 
-        for(unsigned ty = 0; ty < height; ty += 8)
-        for(unsigned tx = 0; tx < width; tx += 8, indices.push_back(index))
+    struct pattern_hash_t
+    {
+        std::size_t operator()(pattern_t const& pattern) const
         {
-            bool any_transparent = false;
-            bool any_opaque = false;
+            std::uint64_t lo, hi;
+            std::memcpy(&lo, pattern.data(), 8);
+            std::memcpy(&hi, pattern.data() + 8, 8);
+            std::uint64_t h = lo * 0x9E3779B97F4A7C15ull;
+            h ^= (hi + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2)) * 0xBF58476D1CE4E5B9ull;
+            return h ^ (h >> 31);
+        }
+    };
 
-            for(unsigned y = 0; y < 8; ++y)
-            for(unsigned x = 0; x < 8; ++x)
-            {
-                bool t = transparent[tx + x + (ty + y)*width];
-                any_transparent |= t;
-                any_opaque      |= !t;
-            }
+    pattern_t hflip(pattern_t pattern)
+    {
+        for(std::uint8_t& row : pattern)
+        {
+            row = ((row & 0xF0) >> 4) | ((row & 0x0F) << 4);
+            row = ((row & 0xCC) >> 2) | ((row & 0x33) << 2);
+            row = ((row & 0xAA) >> 1) | ((row & 0x55) << 1);
+        }
+        return pattern;
+    }
 
-            for(unsigned y = 0; y < 8; ++y)
-            {
-                std::uint8_t v = 0;
-                for(unsigned x = 0; x < 8; ++x)
-                    v |= (image[tx + x + (ty + y)*width] & 1) << (7-x);
-                result.push_back(v);
-            }
+    pattern_t vflip(pattern_t pattern)
+    {
+        std::reverse(pattern.begin(), pattern.begin() + 8);
+        std::reverse(pattern.begin() + 8, pattern.end());
+        return pattern;
+    }
+}
 
-            for(unsigned y = 0; y < 8; ++y)
-            {
-                std::uint8_t v = 0;
-                for(unsigned x = 0; x < 8; ++x)
-                    v |= (image[tx + x + (ty + y)*width] >> 1) << (7-x);
-                result.push_back(v);
-            }
+chr_dedup_t dedup_chr(std::uint8_t const* data, std::size_t size, bool flips)
+{
+    unsigned const num_tiles = std::min<std::size_t>(size / 16, CHR_REMAP_INDEX + 1);
 
-            if(any_transparent && !any_opaque)
-                continue;
+    chr_dedup_t ret;
+    ret.remap.reserve(num_tiles);
 
-            index += 1;
+    std::unordered_map<pattern_t, std::uint16_t, pattern_hash_t> unique;
+    unique.reserve(num_tiles);
+
+    for(unsigned i = 0; i < num_tiles; ++i)
+    {
+        pattern_t pattern;
+        std::copy_n(data + i * 16, 16, pattern.begin());
+
+        auto it = unique.find(pattern);
+        std::uint16_t flags = 0;
+
+        if(flips && it == unique.end())
+        {
+            pattern_t const h = hflip(pattern);
+            pattern_t const v = vflip(pattern);
+
+            if((it = unique.find(h)) != unique.end())
+                flags = CHR_REMAP_HFLIP;
+            else if((it = unique.find(v)) != unique.end())
+                flags = CHR_REMAP_VFLIP;
+            else if((it = unique.find(vflip(h))) != unique.end())
+                flags = CHR_REMAP_HFLIP | CHR_REMAP_VFLIP;
         }
 
-        return { std::move(result), std::move(indices) };
+        if(it == unique.end())
+        {
+            it = unique.emplace(pattern, ret.chr.size() / 16).first;
+            ret.chr.insert(ret.chr.end(), pattern.begin(), pattern.end());
+        }
+
+        ret.remap.push_back(it->second | flags);
     }
-fail:
-    throw std::runtime_error(std::string("png decoder error: ") + lodepng_error_text(error));
+
+    return ret;
 }
 
 attr_gc_bitmaps_t convert_bitmap(attr_bitmaps_t const& bmp)
@@ -11,6 +11,7 @@
 
 #include "2d/geometry.hpp"
 
+#include "compose.hpp"
 #include "guard.hpp"
 #include "graphics.hpp"
 #include "nes_colors.hpp"
@@ -46,10 +47,40 @@ using attr_gc_bitmaps_t = std::array<bitmap_t, 4>;
 
 attr_gc_bitmaps_t convert_bitmap(attr_bitmaps_t const&);
 
-std::vector<attr_bitmaps_t> chr_to_bitmaps(std::uint8_t const* data, std::size_t size, std::uint8_t const* palette,
-                                           std::vector<std::uint16_t> const& indices);
+// The RGB pixels of one CHR tile for each of the 4 attributes.
+// Built without touching wx, so it can be done off the UI thread.
+struct tile_rgb_t
+{
+    bool bad = true;
+    std::array<std::array<rgb_t, 8*8>, 4> rgb;
+};
+
+// The 2-bit color index of every CHR pixel, one byte each, 64 per tile.
+// Decoded once per CHR file so that palette changes only have to recolor.
+struct chr_planes_t
+{
+    std::vector<std::uint8_t> pixels;
+    std::vector<std::uint8_t> bad;
+
+    std::size_t size() const { return bad.size(); }
+    std::uint8_t const* tile(std::size_t i) const { return pixels.data() + i * 64; }
+};
+
+chr_planes_t chr_to_planes(std::uint8_t const* data, std::size_t size, std::vector<std::uint16_t> const& indices);
+
+std::vector<tile_rgb_t> planes_to_rgb(chr_planes_t const& planes, std::uint8_t const* palette);
 
-std::pair<std::vector<bitmap_t>, std::vector<wxBitmap>> load_collision_file(wxString const& string, unsigned scale);
+// Roughly the average color of 'bad_image_xpm'.
+constexpr rgb_t BAD_TILE_RGB = { 28, 14, 28 };
+
+// The average color of each tile, per attribute.
+std::vector<std::array<rgb_t, 4>> average_rgb(std::vector<tile_rgb_t> const& tiles);
+
+// Returns an invalid image if the file can't be read.
+wxImage load_collision_image(wxString const& string);
+
+// Slices the 4x64 collision tileset into tiles of 8*scale pixels.
+std::pair<std::vector<bitmap_t>, std::vector<wxBitmap>> slice_collision_image(wxImage const& base, unsigned scale);
 
 struct chr_patterns_t
 {
@@ -59,4 +90,19 @@ struct chr_patterns_t
 
 chr_patterns_t png_to_chr(std::uint8_t const* png, std::size_t size);
 
+// Flags in 'chr_dedup_t::remap' for patterns that only match once flipped:
+constexpr std::uint16_t CHR_REMAP_HFLIP = 1 << 14;
+constexpr std::uint16_t CHR_REMAP_VFLIP = 1 << 15;
+constexpr std::uint16_t CHR_REMAP_INDEX = 0x3FFF;
+
+struct chr_dedup_t
+{
+    std::vector<std::uint8_t> chr; // Unique patterns, in order of first use.
+    std::vector<std::uint16_t> remap; // Old pattern -> new pattern (and flip flags).
+};
+
+// Collapses duplicate 8x8 patterns.
+// With 'flips' set, a pattern that is a flipped copy of an earlier one collapses too.
+chr_dedup_t dedup_chr(std::uint8_t const* data, std::size_t size, bool flips);
+
 #endif
@@ -1,6 +1,8 @@
 #ifndef GRAPHICS_HPP
 #define GRAPHICS_HPP
 
+#include <vector>
+
 #include <wx/graphics.h>
 
 #ifdef __WXGTK__
@@ -51,6 +53,58 @@ inline void draw_circle(render_t& gc, float x, float y, float radius)
 #endif
 }
 
+// Fills every rect with the current brush, as one path when possible.
+inline void fill_rects(render_t& gc, std::vector<wxRect> const& rects)
+{
+#if GC_RENDER
+    wxGraphicsPath path = gc.CreatePath();
+    for(wxRect const& r : rects)
+        path.AddRectangle(r.x, r.y, r.width, r.height);
+    gc.FillPath(path);
+#else
+    for(wxRect const& r : rects)
+        gc.DrawRectangle(r);
+#endif
+}
+
+// Strokes the disjoint lines from 'begins[i]' to 'ends[i]' with the current pen.
+inline void stroke_segments(render_t& gc, std::vector<wxPoint2DDouble> const& begins, std::vector<wxPoint2DDouble> const& ends)
+{
+#if GC_RENDER
+    gc.StrokeLines(begins.size(), begins.data(), ends.data());
+#else
+    for(std::size_t i = 0; i < begins.size(); ++i)
+        gc.DrawLine(begins[i].m_x, begins[i].m_y, ends[i].m_x, ends[i].m_y);
+#endif
+}
+
+inline bitmap_t make_bitmap(render_t& gc, wxImage const& image)
+{
+#if GC_RENDER
+    return gc.CreateBitmapFromImage(image);
+#else
+    return wxBitmap(image);
+#endif
+}
+
+// Draws a bitmap that was rendered at 'scale' times its logical size, pixel for pixel.
+// 'size' is in device pixels.
+inline void draw_prescaled(render_t& gc, bitmap_t const& bitmap, wxSize size, double x, double y, int scale)
+{
+#if GC_RENDER
+    gc.DrawBitmap(bitmap, x, y, double(size.x) / scale, double(size.y) / scale);
+#else
+    double sx, sy;
+    gc.GetUserScale(&sx, &sy);
+    wxPoint const origin = gc.GetLogicalOrigin();
+    gc.SetUserScale(sx / scale, sy / scale);
+    gc.SetLogicalOrigin(origin.x * scale, origin.y * scale);
+    gc.DrawBitmap(bitmap, x * scale, y * scale);
+    gc.SetLogicalOrigin(origin.x, origin.y);
+    gc.SetUserScale(sx, sy);
+#endif
+}
+
 inline void set_font(render_t& gc, wxFont const& font, wxColour const& color)
 {
 #if GC_RENDER
@@ -1,5 +1,7 @@
 #include "grid_box.hpp"
 
+#include <cstdio>
+
 #include <wx/dcbuffer.h>
 #include <wx/graphics.h>
 #include <wx/dcgraph.h>
@@ -9,7 +11,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 grid_box_t::grid_box_t(wxWindow* parent, bool can_zoom)
-: wxScrolledWindow(parent)
+: wxWindow(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxHSCROLL | wxVSCROLL)
 {
     SetDoubleBuffered(true);
     Bind(wxEVT_LEFT_DCLICK, &grid_box_t::on_left_down, this);
@@ -19,68 +21,504 @@ grid_box_t::grid_box_t(wxWindow* parent, bool can_zoom)
     Bind(wxEVT_RIGHT_DOWN, &grid_box_t::on_right_down, this);
     Bind(wxEVT_RIGHT_UP, &grid_box_t::on_right_up, this);
     Bind(wxEVT_MOTION, &grid_box_t::on_motion, this);
+    Bind(wxEVT_IDLE, &grid_box_t::on_idle, this);
     if(can_zoom)
         Bind(wxEVT_MOUSEWHEEL, &grid_box_t::on_wheel, this);
+    else
+        Bind(wxEVT_MOUSEWHEEL, &grid_box_t::on_scroll_wheel, this);
+
+    for(wxEventType type : { wxEVT_SCROLLWIN_TOP, wxEVT_SCROLLWIN_BOTTOM, wxEVT_SCROLLWIN_LINEUP, wxEVT_SCROLLWIN_LINEDOWN,
+                             wxEVT_SCROLLWIN_PAGEUP, wxEVT_SCROLLWIN_PAGEDOWN, wxEVT_SCROLLWIN_THUMBTRACK, wxEVT_SCROLLWIN_THUMBRELEASE })
+    {
+        Bind(type, &grid_box_t::on_scroll, this);
+    }
+    Bind(wxEVT_SIZE, &grid_box_t::on_size, this);
 
     Bind(wxEVT_UPDATE_UI, &grid_box_t::on_update, this);
 
     Connect(wxEVT_PAINT, wxPaintEventHandler(grid_box_t::on_paint), 0, this);
     SetBackgroundStyle(wxBG_STYLE_PAINT);
+
+    hud_timer.SetOwner(this);
+    Bind(wxEVT_TIMER, &grid_box_t::on_hud_timer, this, hud_timer.GetId());
+}
+
+static wxGraphicsRenderer* paint_renderer()
+{
+#ifdef __WXMSW__
+    return wxGraphicsRenderer::GetDirect2DRenderer();
+#else
+    return wxGraphicsRenderer::GetCairoRenderer();
+#endif
 }
 
 void grid_box_t::on_paint(wxPaintEvent& event)
 {
+    auto const start = perf_clock_t::now();
+    counts = {};
+
+    if(use_backbuffer())
+    {
+        scoped_timer_t timer(counts.backbuffer_ms);
+        update_backbuffer();
+    }
+
+    // Repaints of just the overlay aren't worth counting:
+    wxRect const update_box = GetUpdateRegion().GetBox();
+    bool const record = !show_hud || !hud_box.Contains(update_box);
+
+    paint_rect = to_logical(update_box);
+
 #if GC_RENDER
     wxPaintDC dc(this);
     dc.Clear();
 
-#ifdef __WXMSW__
-    wxGraphicsRenderer* renderer = wxGraphicsRenderer::GetDirect2DRenderer();
-#else
-    wxGraphicsRenderer* renderer = wxGraphicsRenderer::GetCairoRenderer();
-#endif
-
-    std::unique_ptr<wxGraphicsContext> gc(renderer->CreateContext(dc));
+    std::unique_ptr<wxGraphicsContext> gc(paint_renderer()->CreateContext(dc));
     if(gc)
     {
         gc->SetInterpolationQuality(wxINTERPOLATION_NONE);
         gc->SetAntialiasMode(wxANTIALIAS_NONE);
-        gc->Translate(-GetViewStart().x, -GetViewStart().y);
-        gc->Scale(scale, scale);
+        if(use_backbuffer() && backbuffer.IsOk())
+            gc->DrawBitmap(backbuffer, 0, 0, backbuffer.GetWidth(), backbuffer.GetHeight());
+        prepare_view(*gc);
         on_draw(*gc);
+
+        counts.paint_ms = ms_since(start);
+        if(record)
+            stats.record(counts);
+        if(show_hud)
+        {
+            gc->SetTransform(gc->CreateMatrix());
+            draw_hud(*gc);
+        }
     }
 #else
     wxPaintDC dc(this);
-    PrepareDC(dc);
-    dc.SetUserScale(scale, scale);
+    if(use_backbuffer() && backbuffer.IsOk())
+        dc.DrawBitmap(backbuffer, 0, 0);
+    prepare_view(dc);
     on_draw(dc);
+
+    counts.paint_ms = ms_since(start);
+    if(record)
+        stats.record(counts);
+    if(show_hud)
+    {
+        dc.SetDeviceOrigin(0, 0);
+        dc.SetLogicalOrigin(0, 0);
+        dc.SetUserScale(1, 1);
+        dc.SetLogicalScale(1, 1);
+        draw_hud(dc);
+    }
+#endif
+
+    painted_overlay = overlay_rect();
+
+    if(show_hud && !hud_timer.IsRunning())
+        hud_timer.Start(250);
+}
+
+void grid_box_t::prepare_view(render_t& gc) const
+{
+    // Split the offset into whole unscaled pixels and a scaled remainder, which both fit the renderer's coordinates:
+    int const px = view_x / scale;
+    int const py = view_y / scale;
+    int const rx = view_x % scale;
+    int const ry = view_y % scale;
+#if GC_RENDER
+    gc.Translate(-rx, -ry);
+    gc.Scale(scale, scale);
+    gc.Translate(-px, -py);
+#else
+    gc.SetDeviceOrigin(-rx, -ry);
+    gc.SetUserScale(scale, scale);
+    gc.SetLogicalOrigin(px, py);
+#endif
+}
+
+void grid_box_t::draw_hud(render_t& gc)
+{
+    paint_counts_t const& last = stats.last();
+
+    std::vector<wxString> lines;
+    lines.push_back(wxString::Format("paint %.2f ms, avg %.2f ms", last.paint_ms, stats.average_ms()));
+    lines.push_back(wxString::Format("backbuffer %.2f ms", last.backbuffer_ms));
+    lines.push_back(wxString::Format("%u tiles, %u rects, %u objects", last.tiles, last.rects, last.objects));
+    lines.push_back(wxString::Format("%u repaints/s", stats.per_second()));
+    hud_lines(lines);
+
+    // The font is fixed width, so one measurement covers every line:
+    if(!hud_font.IsOk())
+        hud_font = wxFont(wxFontInfo(8).Family(wxFONTFAMILY_TELETYPE));
+    set_font(gc, hud_font, *wxWHITE);
+    if(!hud_char.x)
+        text_extent(gc, "0", &hud_char.x, &hud_char.y);
+
+    std::size_t columns = 0;
+    for(wxString const& line : lines)
+        columns = std::max(columns, line.length());
+
+    hud_box = wxRect(4, 4, int(columns) * hud_char.x + 8, int(lines.size()) * hud_char.y + 8);
+    gc.SetPen(*wxTRANSPARENT_PEN);
+    gc.SetBrush(wxBrush(wxColor(0, 0, 0, 192)));
+    gc.DrawRectangle(hud_box.x, hud_box.y, hud_box.width, hud_box.height);
+
+    int y = hud_box.y + 4;
+    for(wxString const& line : lines)
+    {
+        gc.DrawText(line, hud_box.x + 4, y);
+        y += hud_char.y;
+    }
+}
+
+void grid_box_t::on_hud_timer(wxTimerEvent& event)
+{
+    if(!show_hud)
+    {
+        hud_timer.Stop();
+        Refresh();
+        return;
+    }
+
+    if(IsShownOnScreen())
+        RefreshRect(hud_box, false);
+}
+
+void grid_box_t::refresh_overlay()
+{
+    rect_t r = painted_overlay;
+    if(rect_t const now = overlay_rect())
+        r = r ? grow_rect_to_contain(r, now) : now;
+    if(!r)
+        return;
+
+    // Pad by a pixel to cover pen widths:
+    wxRect const box = to_device({ coord_t{ r.c.x - 1, r.c.y - 1 }, dimen_t{ r.d.w + 2, r.d.h + 2 } });
+    if(!box.IsEmpty())
+        RefreshRect(box, false);
+}
+
+rect_t grid_box_t::to_logical(wxRect box) const
+{
+    coord_t const c0 = { int((box.GetLeft() + view_x) / scale), int((box.GetTop() + view_y) / scale) };
+    coord_t const c1 = { int((box.GetRight() + view_x) / scale + 1), int((box.GetBottom() + view_y) / scale + 1) };
+    return { c0, dimen_t{ c1.x - c0.x, c1.y - c0.y } };
+}
+
+wxRect grid_box_t::to_device(rect_t r) const
+{
+    // Clipped to the window, as far off rects don't fit an int once scrolled:
+    wxSize const size = GetClientSize();
+    std::int64_t const x0 = std::clamp<std::int64_t>(std::int64_t(r.c.x) * scale - view_x, 0, size.x);
+    std::int64_t const y0 = std::clamp<std::int64_t>(std::int64_t(r.c.y) * scale - view_y, 0, size.y);
+    std::int64_t const x1 = std::clamp<std::int64_t>(std::int64_t(r.e().x) * scale - view_x, 0, size.x);
+    std::int64_t const y1 = std::clamp<std::int64_t>(std::int64_t(r.e().y) * scale - view_y, 0, size.y);
+    return wxRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void grid_box_t::update_backbuffer()
+{
+    static constexpr std::size_t MAX_DIRTY = 32;
+
+    wxSize const size = GetClientSize();
+    if(size.x <= 0 || size.y <= 0)
+        return;
+
+    backbuffer_state_t const state = { size.x, size.y, view_x, view_y, scale, backbuffer_key() };
+
+    // Scrolls keep what's already drawn:
+    backbuffer_state_t unscrolled = backbuffer_state;
+    unscrolled.sx = state.sx;
+    unscrolled.sy = state.sy;
+
+    std::vector<rect_t> dirty;
+    bool partial = collect_dirty(dirty) && backbuffer_valid && state == unscrolled;
+    if(partial && !(state == backbuffer_state))
+    {
+        partial = scroll_backbuffer(state.sx - backbuffer_state.sx, state.sy - backbuffer_state.sy, dirty);
+        backbuffer_state = state;
+    }
+
+    if(!partial)
+    {
+        if(!backbuffer.IsOk() || backbuffer.GetSize() != size)
+            backbuffer.Create(size);
+        dirty.assign(1, to_logical(wxRect(size)));
+        backbuffer_state = state;
+        backbuffer_valid = true;
+    }
+    else if(dirty.empty())
+        return;
+    else if(dirty.size() > MAX_DIRTY)
+    {
+        rect_t bounds = dirty.front();
+        for(rect_t const& r : dirty)
+            bounds = grow_rect_to_contain(bounds, r);
+        dirty.assign(1, bounds);
+    }
+
+    wxMemoryDC mdc(backbuffer);
+    wxBrush const background(GetBackgroundColour());
+    bool const composed = use_compositor();
+
+    if(composed)
+    {
+        wxColour const color = GetBackgroundColour();
+        for(rect_t const& r : dirty)
+        {
+            wxRect const box = to_device(r);
+            if(box.IsEmpty())
+                continue;
+            wxImage image(box.GetSize(), false);
+            image.SetRGB(wxRect(box.GetSize()), color.Red(), color.Green(), color.Blue());
+            compose_backbuffer(image, { int(-view_x - box.x), int(-view_y - box.y) });
+            mdc.DrawBitmap(wxBitmap(image), box.GetPosition());
+        }
+    }
+
+#if GC_RENDER
+    std::unique_ptr<wxGraphicsContext> gc(paint_renderer()->CreateContext(mdc));
+    if(!gc)
+        return;
+    gc->SetInterpolationQuality(wxINTERPOLATION_NONE);
+    gc->SetAntialiasMode(wxANTIALIAS_NONE);
+    prepare_view(*gc);
+
+    for(rect_t const& r : dirty)
+    {
+        gc->Clip(r.c.x, r.c.y, r.d.w, r.d.h);
+        if(!composed)
+        {
+            gc->SetPen(*wxTRANSPARENT_PEN);
+            gc->SetBrush(background);
+            gc->DrawRectangle(r.c.x, r.c.y, r.d.w, r.d.h);
+        }
+        paint_rect = r;
+        draw_backbuffer(*gc);
+        gc->ResetClip();
+    }
+#else
+    prepare_view(mdc);
+
+    for(rect_t const& r : dirty)
+    {
+        mdc.SetClippingRegion(r.c.x, r.c.y, r.d.w, r.d.h);
+        if(!composed)
+        {
+            mdc.SetPen(*wxTRANSPARENT_PEN);
+            mdc.SetBrush(background);
+            mdc.DrawRectangle(r.c.x, r.c.y, r.d.w, r.d.h);
+        }
+        paint_rect = r;
+        draw_backbuffer(mdc);
+        mdc.DestroyClippingRegion();
+    }
 #endif
 }
 
+bool grid_box_t::scroll_backbuffer(std::int64_t dx, std::int64_t dy, std::vector<rect_t>& dirty)
+{
+    wxSize const size = backbuffer.GetSize();
+    if(std::abs(dx) >= size.x || std::abs(dy) >= size.y)
+        return false;
+
+    int const w = size.x - std::abs(dx);
+    int const h = size.y - std::abs(dy);
+
+    if(!scroll_spare.IsOk() || scroll_spare.GetSize() != size)
+        scroll_spare.Create(size);
+    {
+        wxMemoryDC src(backbuffer);
+        wxMemoryDC dst(scroll_spare);
+        dst.Blit(std::max<int>(0, -dx), std::max<int>(0, -dy), w, h, &src, std::max<int>(0, dx), std::max<int>(0, dy));
+    }
+    std::swap(backbuffer, scroll_spare);
+
+    if(dx > 0)
+        dirty.push_back(to_logical(wxRect(w, 0, dx, size.y)));
+    else if(dx < 0)
+        dirty.push_back(to_logical(wxRect(0, 0, -dx, size.y)));
+
+    if(dy > 0)
+        dirty.push_back(to_logical(wxRect(0, h, size.x, dy)));
+    else if(dy < 0)
+        dirty.push_back(to_logical(wxRect(0, 0, size.x, -dy)));
+
+    return true;
+}
+
 void grid_box_t::grid_resize(dimen_t dimen)
 {
     if(grid_dimen == dimen)
         return;
     grid_dimen = dimen;
-    int const w = (dimen.w * tile_size().w + margin().w * 2) * scale;
-    int const h = (dimen.h * tile_size().h + margin().h * 2) * scale;
-    int sx, sy;
-    GetViewStart(&sx, &sy);
-    SetScrollbars(1,1, w, h, sx, sy);
-    SetMinSize({ w, h });
+    SetMinSize({ int(std::min<std::int64_t>(virtual_extent(wxHORIZONTAL), MAX_MIN_SIZE)), 
+                 int(std::min<std::int64_t>(virtual_extent(wxVERTICAL), MAX_MIN_SIZE)) });
+    scroll_to(view_x, view_y);
+    update_scrollbars();
 }
 
-coord_t grid_box_t::from_screen(coord_t pixel, dimen_t tile_size, int user_scale) const
+std::int64_t grid_box_t::virtual_extent(int orient) const
+{
+    if(orient == wxHORIZONTAL)
+        return (std::int64_t(grid_dimen.w) * tile_size().w + margin().w * 2) * scale;
+    return (std::int64_t(grid_dimen.h) * tile_size().h + margin().h * 2) * scale;
+}
+
+int grid_box_t::to_native(std::int64_t pixels, std::int64_t extent) const
+{
+    if(extent <= NATIVE_SCROLL_RANGE)
+        return pixels;
+    return pixels * NATIVE_SCROLL_RANGE / extent;
+}
+
+void grid_box_t::update_scrollbars()
+{
+    wxSize const size = GetClientSize();
+    for(int orient : { wxHORIZONTAL, wxVERTICAL })
+    {
+        std::int64_t const extent = virtual_extent(orient);
+        std::int64_t const page = orient == wxHORIZONTAL ? size.x : size.y;
+        std::int64_t const pos = orient == wxHORIZONTAL ? view_x : view_y;
+        int const range = to_native(extent, extent);
+        if(extent <= page)
+            SetScrollbar(orient, 0, 0, 0);
+        else
+            SetScrollbar(orient, to_native(pos, extent), std::max(1, to_native(page, extent)), range);
+    }
+}
+
+void grid_box_t::scroll_to(std::int64_t x, std::int64_t y)
+{
+    wxSize const size = GetClientSize();
+    x = std::clamp<std::int64_t>(x, 0, std::max<std::int64_t>(0, virtual_extent(wxHORIZONTAL) - size.x));
+    y = std::clamp<std::int64_t>(y, 0, std::max<std::int64_t>(0, virtual_extent(wxVERTICAL) - size.y));
+    if(x == view_x && y == view_y)
+        return;
+
+    view_x = x;
+    view_y = y;
+    update_scrollbars();
+    Refresh();
+}
+
+void grid_box_t::on_scroll(wxScrollWinEvent& event)
+{
+    int const orient = event.GetOrientation();
+    std::int64_t const extent = virtual_extent(orient);
+    std::int64_t const page = orient == wxHORIZONTAL ? GetClientSize().x : GetClientSize().y;
+    std::int64_t pos = orient == wxHORIZONTAL ? view_x : view_y;
+
+    wxEventType const type = event.GetEventType();
+    if(type == wxEVT_SCROLLWIN_TOP)
+        pos = 0;
+    else if(type == wxEVT_SCROLLWIN_BOTTOM)
+        pos = extent;
+    else if(type == wxEVT_SCROLLWIN_LINEUP)
+        pos -= SCROLL_LINE;
+    else if(type == wxEVT_SCROLLWIN_LINEDOWN)
+        pos += SCROLL_LINE;
+    else if(type == wxEVT_SCROLLWIN_PAGEUP)
+        pos -= page;
+    else if(type == wxEVT_SCROLLWIN_PAGEDOWN)
+        pos += page;
+    else if(extent <= NATIVE_SCROLL_RANGE) // Thumb
+        pos = event.GetPosition();
+    else
+        pos = std::int64_t(event.GetPosition()) * extent / NATIVE_SCROLL_RANGE;
+
+    if(orient == wxHORIZONTAL)
+        scroll_to(pos, view_y);
+    else
+        scroll_to(view_x, pos);
+}
+
+void grid_box_t::on_scroll_wheel(wxMouseEvent& event)
+{
+    int const lines = -event.GetWheelRotation() * event.GetLinesPerAction() / event.GetWheelDelta();
+    if(event.GetWheelAxis() == wxMOUSE_WHEEL_HORIZONTAL)
+        scroll_to(view_x - lines * SCROLL_LINE, view_y);
+    else
+        scroll_to(view_x, view_y + lines * SCROLL_LINE);
+}
+
+void grid_box_t::on_size(wxSizeEvent& event)
+{
+    scroll_to(view_x, view_y);
+    update_scrollbars();
+    event.Skip();
+}
+
+void grid_box_t::draw_shape(render_t& gc, tile_shape_t const& shape, coord_t offset, dimen_t bounds, wxPen const& pen, wxBrush const& brush)
+{
+    rect_t const clip = visible_tiles(bounds);
+    if(!clip)
+        return;
+
+    dimen_t const ts = tile_size();
+    auto const to_pixel = [&](coord_t c) { return wxPoint2DDouble(c.x * ts.w + margin().w, c.y * ts.h + margin().h); };
+
+    std::vector<wxRect> rects;
+    for(rect_t r : shape.rects)
+    {
+        if(!(r = crop(rect_t{ r.c + offset - clip.c, r.d }, clip.d)))
+            continue;
+        r.c = r.c + clip.c;
+        rects.emplace_back(r.c.x * ts.w + margin().w, r.c.y * ts.h + margin().h, r.d.w * ts.w, r.d.h * ts.h);
+    }
+
+    std::vector<wxPoint2DDouble> begins, ends;
+    for(auto [a, b] : shape.outline)
+    {
+        a = a + offset;
+        b = b + offset;
+        if(a.y == b.y) // Horizontal
+        {
+            if(a.y < clip.c.y || a.y > clip.e().y)
+                continue;
+            a.x = std::max(a.x, clip.c.x);
+            b.x = std::min(b.x, clip.e().x);
+            if(a.x >= b.x)
+                continue;
+        }
+        else // Vertical
+        {
+            if(a.x < clip.c.x || a.x > clip.e().x)
+                continue;
+            a.y = std::max(a.y, clip.c.y);
+            b.y = std::min(b.y, clip.e().y);
+            if(a.y >= b.y)
+                continue;
+        }
+        begins.push_back(to_pixel(a));
+        ends.push_back(to_pixel(b));
+    }
+
+    counts.rects += rects.size() + begins.size();
+
+    gc.SetPen(*wxTRANSPARENT_PEN);
+    gc.SetBrush(brush);
+    fill_rects(gc, rects);
+
+    gc.SetPen(pen);
+    stroke_segments(gc, begins, ends);
+}
+
+rect_t grid_box_t::visible_tiles(dimen_t tile_size, dimen_t dimen) const
 {
-    int sx, sy;
-    GetViewStart(&sx, &sy);
+    // Round outwards, so that partially covered tiles are included:
+    auto const floor_div = [](int a, int b) { return a >= 0 ? a / b : (a - b + 1) / b; };
+    coord_t const c0 = paint_rect.c - to_coord(margin());
+    coord_t const c1 = paint_rect.e() - to_coord(margin());
+    coord_t const t0 = { floor_div(c0.x, tile_size.w), floor_div(c0.y, tile_size.h) };
+    coord_t const t1 = { floor_div(c1.x + tile_size.w - 1, tile_size.w), floor_div(c1.y + tile_size.h - 1, tile_size.h) };
+    return crop(rect_t{ t0, dimen_t{ t1.x - t0.x, t1.y - t0.y } }, dimen);
+}
 
-    pixel.x += sx;
-    pixel.y += sy;
-    pixel.x *= user_scale;
-    pixel.y *= user_scale;
-    pixel.x /= scale;
-    pixel.y /= scale;
+coord_t grid_box_t::from_screen(coord_t pixel, dimen_t tile_size, int user_scale) const
+{
+    pixel.x = (pixel.x + view_x) * user_scale / scale;
+    pixel.y = (pixel.y + view_y) * user_scale / scale;
     pixel.x -= margin().w;
     pixel.y -= margin().h;
     pixel.x /= tile_size.w;
@@ -99,6 +537,7 @@ coord_t grid_box_t::to_screen(coord_t c, dimen_t tile_size) const
 
 void grid_box_t::on_down(wxMouseEvent& event, mouse_button_t mb) 
 {
+    flush_motion();
     SetFocus();
 
     if(mouse_down && mouse_down != mb)
@@ -116,6 +555,7 @@ void grid_box_t::on_down(wxMouseEvent& event, mouse_button_t mb)
 
 void grid_box_t::on_up(wxMouseEvent& event, mouse_button_t mb) 
 {
+    flush_motion();
     if(mouse_down == mb)
     {
         mouse_down = MB_NONE;
@@ -128,18 +568,29 @@ void grid_box_t::on_motion(wxMouseEvent& event)
 {
     wxPoint pos = event.GetPosition();
     mouse_current = { pos.x, pos.y };
+    motion_pending = true;
+}
+
+void grid_box_t::flush_motion()
+{
+    if(!motion_pending)
+        return;
+    motion_pending = false;
     on_motion(mouse_current);
 }
 
 void grid_box_t::on_wheel(wxMouseEvent& event)
 {
+    // Zoom through in-between factors too, not just powers of two:
+    static constexpr int steps[] = { 1, 2, 3, 4, 6, 8, 12, 16 };
+    static constexpr int num_steps = std::size(steps);
+
     int const rot = event.GetWheelRotation();
     int const delta = event.GetWheelDelta();
     int const turns = rot / delta;
-    int const target = turns >= 0 ? (scale << turns) : (scale >> -turns);
-    int const diff = target - scale;
 
-    int const new_scale = std::clamp(scale + diff, 1, 16);
+    int const i = std::upper_bound(steps, steps + num_steps, scale) - steps - 1;
+    int const new_scale = steps[std::clamp(i + turns, 0, num_steps - 1)];
     auto cursor = event.GetPosition();
     set_zoom(new_scale, cursor);
 }
@@ -149,43 +600,29 @@ void grid_box_t::set_zoom(int new_scale, wxPoint cursor)
     if(new_scale == scale)
         return;
 
-    int const diff = new_scale - scale;
-    double const scale_diff = double(new_scale) / double(scale);
-
-    int sx, sy;
-    GetViewStart(&sx, &sy);
-    sx *= new_scale;
-    sy *= new_scale;
-    sx += cursor.x * diff;
-    sy += cursor.y * diff;
-    sx /= scale;
-    sy /= scale;
-
-    int const w = (grid_dimen.w * tile_size().w + margin().w * 2) * new_scale;
-    int const h = (grid_dimen.h * tile_size().h + margin().h * 2) * new_scale;
-    sx = std::clamp(sx, 0, w);
-    sy = std::clamp(sy, 0, h);
+    // Keep the pixel under the cursor in place:
+    std::int64_t const x = (view_x + cursor.x) * new_scale / scale - cursor.x;
+    std::int64_t const y = (view_y + cursor.y) * new_scale / scale - cursor.y;
     scale = new_scale;
 
-    SetScrollbars(1,1, w, h, sx, sy);
-
-    // Hack to fix the scroll bar:
-    wxPoint p = CalcScrolledPosition({ 0, 0 });
-    Scroll(-p.x + 1, -p.y + 1);
-    Scroll(-p.x, -p.y);
-
+    scroll_to(x, y);
+    update_scrollbars();
     Refresh();
 }
 
+void grid_box_t::center_on(coord_t pixel)
+{
+    wxSize const size = GetClientSize();
+    scroll_to(std::int64_t(pixel.x) * scale - size.x / 2, std::int64_t(pixel.y) * scale - size.y / 2);
+}
+
 void grid_box_t::set_scale(int new_scale)
 {
     new_scale = std::clamp(new_scale, 1, 8);
 
     coord_t s = to_screen(mouse_current);
-    int const w = (grid_dimen.w * tile_size().w + margin().w * 2) * scale;
-    int const h = (grid_dimen.h * tile_size().h + margin().h * 2) * scale;
-    SetScrollbars(1,1, w, h, s.x, s.y);
-    SetMinSize({ w, h });
+    scroll_to(s.x, s.y);
+    update_scrollbars();
 
     Refresh();
 }
@@ -236,27 +673,37 @@ void selector_box_t::on_up(mouse_button_t mb, coord_t mouse_end)
 
 void selector_box_t::on_motion(coord_t at)
 {
-    std::stringstream status;
-    auto c = from_screen(mouse_current);
-    if(in_bounds(c, grid_dimen))
-        status << "{$" << std::hex << (tile_value(c) & 0xFF) << std::dec << "}";
-    model.status_bar->SetStatusText(status.str());
+    coord_t const c = from_screen(mouse_current);
+    bool const inside = in_bounds(c, grid_dimen);
+    if(status_changed(inside ? c : coord_t{ -1, -1 }, inside ? tile_value(c) : -1))
+    {
+        char status[32] = "";
+        if(inside)
+            std::snprintf(status, sizeof(status), "{$%x}", tile_value(c) & 0xFF);
+        set_status(status);
+    }
 
     if(!enable_tile_select())
         return;
 
     if(mouse_down)
-        Refresh();
+        refresh_overlay();
 }
 
-void selector_box_t::draw_tiles(render_t& gc)
+rect_t selector_box_t::overlay_rect() const
 {
-    //dc.SetUserScale(scale, scale);
+    if(!enable_tile_select() || !mouse_down)
+        return {};
 
-    if(!enable_tile_select())
-        return;
+    return to_screen(rect_from_2_coords(from_screen(mouse_start), from_screen(mouse_current)), tile_size());
+}
 
-    for(coord_t c : dimen_range(selector().dimen()))
+void selector_box_t::draw_sheet(render_t& gc)
+{
+    rect_t const visible = visible_tiles(selector().dimen());
+    counts.tiles += visible.d.w * visible.d.h;
+
+    for(coord_t c : rect_range(visible))
     {
         int x0 = c.x * tile_size().w + margin().w;
         int y0 = c.y * tile_size().h + margin().h;
@@ -264,17 +711,20 @@ void selector_box_t::draw_tiles(render_t& gc)
         unsigned const tile = tiles().layer().to_tile(c);
         draw_tile(gc, tile, { x0, y0 });
     }
+}
+
+void selector_box_t::draw_tiles(render_t& gc)
+{
+    //dc.SetUserScale(scale, scale);
 
-    gc.SetPen(wxPen(wxColor(255, 255, 255, 127), 0));
-    gc.SetBrush(wxBrush(wxColor(0, 255, 255, 127)));
+    if(!enable_tile_select())
+        return;
 
-    for(coord_t c : dimen_range(selector().dimen()))
-    {
-        int x0 = c.x * tile_size().w + margin().w;
-        int y0 = c.y * tile_size().h + margin().h;
-        if(selector()[c])
-            gc.DrawRectangle(x0, y0, tile_size().w, tile_size().h);
-    }
+    if(!use_backbuffer())
+        draw_sheet(gc);
+
+    draw_shape(gc, selector().shape(), {}, selector().dimen(), 
+               wxPen(wxColor(255, 255, 255, 127), 0), wxBrush(wxColor(0, 255, 255, 127)));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -344,6 +794,22 @@ void canvas_box_t::on_up(mouse_button_t mb, coord_t mouse_end)
 
         post_update();
     }
+    else if(model.tool == TOOL_BUCKET && mb == MBTN_LEFT)
+    {
+        // Fills with the top-left picked tile, or with just the active attribute while holding shift:
+        rect_t const picked = layer().picker_selector.select_rect();
+        std::uint32_t const mask = wxGetKeyState(WXK_SHIFT) && layer().attribute_mask() ? layer().attribute_mask() : ~0u;
+        if(!picked || !in_bounds(pen, layer().canvas_dimen()))
+            return;
+
+        undo_t undo = layer().flood_fill(pen, layer().to_tile(picked.c), mask);
+        if(std::holds_alternative<std::monostate>(undo))
+            return;
+        model.modify();
+        editor().history.push(std::move(undo));
+
+        post_update();
+    }
 
     Refresh();
 }
@@ -352,21 +818,42 @@ void canvas_box_t::on_motion(coord_t at)
 {
     grid_box_t::on_motion(at);
 
-    std::stringstream status;
-    auto c = from_screen(mouse_current);
-    if(in_bounds(c, grid_dimen))
+    coord_t const c = from_screen(mouse_current);
+    bool const inside = in_bounds(c, grid_dimen);
+    if(status_changed(inside ? c : coord_t{ -1, -1 }, inside ? tile_value(c) : -1))
     {
-        status << "{$" << std::hex << (tile_value(c) & 0xFF) << std::dec << "}";
-        while(status.str().size() < 6)
-            status << ' ';
-        status << "(" << c.x << ", " << c.y << ") ";
-        while(status.str().size() < 17)
-            status << ' ';
-        status << "[$" << std::hex << tile_code(c) << std::dec << "]";
+        char status[64] = "";
+        if(inside)
+        {
+            char value[16], position[32];
+            std::snprintf(value, sizeof(value), "{$%x}", tile_value(c) & 0xFF);
+            std::snprintf(position, sizeof(position), "(%d, %d) ", c.x, c.y);
+            std::snprintf(status, sizeof(status), "%-6s%-11s[$%x]", value, position, unsigned(tile_code(c)));
+        }
+        set_status(status);
     }
-    model.status_bar->SetStatusText(status.str());
 
-    Refresh();
+    refresh_overlay();
+}
+
+rect_t canvas_box_t::overlay_rect() const
+{
+    coord_t const pen = from_screen(mouse_current);
+
+    if(pasting())
+    {
+        if(auto* grid = std::get_if<grid_t<std::uint32_t>>(&model.paste->data))
+            return to_screen(rect_t{ pen, grid->dimen() }, tile_size());
+        return {};
+    }
+
+    if(model.tool == TOOL_SELECT)
+        return selector_box_t::overlay_rect();
+
+    if(model.tool == TOOL_STAMP)
+        return to_screen(rect_t{ pen, layer().picker_selector.select_rect().d }, tile_size());
+
+    return {};
 }
 
 void canvas_box_t::draw_tiles(render_t& gc)
@@ -377,7 +864,10 @@ void canvas_box_t::draw_tiles(render_t& gc)
 
 void canvas_box_t::draw_underlays(render_t& gc)
 {
-    for(coord_t c : dimen_range(layer().canvas_dimen()))
+    rect_t const visible = visible_tiles(layer().canvas_dimen());
+    counts.tiles += visible.d.w * visible.d.h;
+
+    for(coord_t c : rect_range(visible))
     {
         int x0 = c.x * tile_size().w + margin().w;
         int y0 = c.y * tile_size().h + margin().h;
@@ -394,46 +884,20 @@ void canvas_box_t::draw_overlays(render_t& gc)
 
     if(model.tool == TOOL_SELECT)
     {
-        for(coord_t c : dimen_range(layer().canvas_selector.dimen()))
-        {
-            int x0 = c.x * tile_size().w + margin().w;
-            int y0 = c.y * tile_size().h + margin().h;
-
-            if(model.tool == TOOL_SELECT && layer().canvas_selector[c])
-            {
-                gc.SetPen(wxPen(wxColor(255, 255, 255, 127), 0));
-                gc.SetBrush(wxBrush(wxColor(0, 255, 255, 127)));
-                gc.DrawRectangle(x0, y0, tile_size().w, tile_size().h);
-            }
-        }
+        draw_shape(gc, layer().canvas_selector.shape(), {}, layer().canvas_dimen(), 
+                   wxPen(wxColor(255, 255, 255, 127), 0), wxBrush(wxColor(0, 255, 255, 127)));
     }
 
     if(pasting())
     {
-        if(auto* grid = std::get_if<grid_t<std::uint32_t>>(&model.paste->data))
-        {
-            gc.SetPen(wxPen(wxColor(255, 255, 0), 0));
-            gc.SetBrush(wxBrush(wxColor(255, 0, 255, 127)));
-            coord_t const pen = from_screen(mouse_current);
-            for(coord_t c : dimen_range(grid->dimen()))
-            {
-                if((*grid)[c] != std::uint32_t(~0u))
-                {
-                    coord_t const c0 = to_screen(c + pen);
-                    gc.DrawRectangle(c0.x, c0.y, tile_size().w, tile_size().h);
-                }
-            }
-        }
+        draw_shape(gc, model.paste->shape(), from_screen(mouse_current), layer().canvas_dimen(), 
+                   wxPen(wxColor(255, 255, 0), 0), wxBrush(wxColor(255, 0, 255, 127)));
     }
     else if(model.tool == TOOL_STAMP)
     {
-        gc.SetPen(wxPen(wxColor(255, 255, 255, 127), 0));
-        gc.SetBrush(wxBrush(wxColor(0, 255, 255, mouse_down == MBTN_LEFT ? 127 : 31)));
-        layer().for_each_picked(from_screen(mouse_current), [&](coord_t c, std::uint8_t tile)
-        {
-            coord_t const c0 = to_screen(c);
-            gc.DrawRectangle(c0.x, c0.y, tile_size().w, tile_size().h);
-        });
+        coord_t const pen = from_screen(mouse_current);
+        draw_shape(gc, layer().picker_selector.shape(), pen - layer().picker_selector.select_rect().c, layer().canvas_dimen(), 
+                   wxPen(wxColor(255, 255, 255, 127), 0), wxBrush(wxColor(0, 255, 255, mouse_down == MBTN_LEFT ? 127 : 31)));
     }
 }
 
@@ -2,6 +2,7 @@
 #define GRID_BOX_HPP
 
 #include <bit>
+#include <cstdint>
 #include <unordered_set>
 #include <type_traits>
 
@@ -13,6 +14,7 @@
 
 #include "id.hpp"
 #include "model.hpp"
+#include "perf.hpp"
 
 using namespace i2d;
 
@@ -227,7 +229,7 @@ private:
     int rtab_id = -1;
 };
 
-class grid_box_t : public wxScrolledWindow
+class grid_box_t : public wxWindow
 {
 public:
     explicit grid_box_t(wxWindow* parent, bool can_zoom = true);
@@ -251,14 +253,72 @@ public:
     coord_t to_screen(coord_t c, dimen_t tile_size) const;
 
     void set_zoom(int amount, wxPoint position);
+
+    // The part of the view that's on screen, in unscaled pixels.
+    rect_t view_rect() const { return to_logical(wxRect(GetClientSize())); }
+
+    // Scrolls so that 'pixel' (unscaled) is in the middle of the window.
+    void center_on(coord_t pixel);
+
+    // Scrolls the top-left of the window to 'x, y' scaled pixels, clamped to the grid.
+    void scroll_to(std::int64_t x, std::int64_t y);
+
+    // Draws paint timings and counts over every grid box.
+    static inline bool show_hud = false;
 protected:
     dimen_t grid_dimen = {};
     mouse_button_t mouse_down = MB_NONE;
     coord_t mouse_current = {};
     int scale = 2;
 
+    // The scroll offset, in scaled pixels.
+    // Kept in 64 bits so huge grids at high zoom don't overflow, as the native scroll bars only cover a bounded range.
+    std::int64_t view_x = 0;
+    std::int64_t view_y = 0;
+
+    // The area being repainted, in unscaled pixels. Only valid while drawing.
+    rect_t paint_rect = {};
+
+    // Reset at the start of every paint, for the overlay.
+    paint_counts_t counts = {};
+
+    // Views with costly, mostly static content can draw it into a viewport sized backbuffer.
+    // Each paint redraws only the pixel rects reported by 'collect_dirty',
+    // or everything when it returns false or 'backbuffer_key' changes.
+    virtual bool use_backbuffer() const { return false; }
+    virtual std::uint64_t backbuffer_key() const { return 0; }
+    virtual bool collect_dirty(std::vector<rect_t>& dirty) { return false; }
+    virtual void draw_backbuffer(render_t& gc) {}
+    void invalidate_backbuffer() { backbuffer_valid = false; }
+
+    // Views can also write backbuffer pixels directly, before 'draw_backbuffer' draws on top.
+    // 'origin' is where logical (0, 0) lands in 'image', which is already scaled and filled with the background.
+    virtual bool use_compositor() const { return false; }
+    virtual void compose_backbuffer(wxImage& image, coord_t origin) {}
+
+    rect_t to_screen(rect_t r, dimen_t tile_size) const 
+    { 
+        return { to_screen(r.c, tile_size), dimen_t{ r.d.w * tile_size.w, r.d.h * tile_size.h } }; 
+    }
+
+    // The area covered by overlays that follow the mouse, in unscaled pixels.
+    virtual rect_t overlay_rect() const { return {}; }
+
+    // Repaints only where the overlays were last drawn and where they are now.
+    void refresh_overlay();
+
+    // The tiles of a 'dimen' sized grid which overlap 'paint_rect'.
+    rect_t visible_tiles(dimen_t tile_size, dimen_t dimen) const;
+    rect_t visible_tiles(dimen_t dimen) const { return visible_tiles(tile_size(), dimen); }
+
+    // Fills 'shape' and outlines it, offset by 'offset' tiles and culled to the visible part of 'bounds'.
+    void draw_shape(render_t& gc, tile_shape_t const& shape, coord_t offset, dimen_t bounds, wxPen const& pen, wxBrush const& brush);
+
     virtual void draw_tiles(render_t& gc) = 0;
 
+    // Extra lines for the overlay.
+    virtual void hud_lines(std::vector<wxString>& lines) const {}
+
     virtual void on_down(mouse_button_t mb, coord_t) {}
     virtual void on_up(mouse_button_t mb, coord_t) {}
     virtual void on_motion(coord_t) {}
@@ -268,12 +328,68 @@ protected:
     void on_motion(wxMouseEvent& event);
     void on_wheel(wxMouseEvent& event);
 
+    // Motion is handled at most once per event loop pass, with the latest position.
+    // Clicks flush it first, so handlers still see motion before the button.
+    void on_idle(wxIdleEvent& event) { flush_motion(); event.Skip(); }
+    void flush_motion();
+
     void on_left_down(wxMouseEvent& event)  { on_down(event, MBTN_LEFT); }
     void on_left_up(wxMouseEvent& event)    { on_up(event,   MBTN_LEFT); }
     void on_right_down(wxMouseEvent& event) { on_down(event, MBTN_RIGHT); }
     void on_right_up(wxMouseEvent& event)   { on_up(event,   MBTN_RIGHT); }
 
     void set_scale(int new_scale);
+
+private:
+    static constexpr int NATIVE_SCROLL_RANGE = 1 << 15;
+    static constexpr int SCROLL_LINE = 16;
+    static constexpr int MAX_MIN_SIZE = 512; // Big grids scroll rather than stretch their parent.
+
+    rect_t to_logical(wxRect box) const;
+    wxRect to_device(rect_t r) const;
+    void update_backbuffer();
+
+    // Moves the backbuffer's pixels by a scroll of 'dx, dy' and adds the exposed strips to 'dirty'.
+    // Returns false when nothing can be kept.
+    bool scroll_backbuffer(std::int64_t dx, std::int64_t dy, std::vector<rect_t>& dirty);
+
+    // The grid's width or height, in scaled pixels.
+    std::int64_t virtual_extent(int orient) const;
+    int to_native(std::int64_t pixels, std::int64_t extent) const;
+    void update_scrollbars();
+
+    // Sets up 'gc' to draw in unscaled pixels at the current scroll offset.
+    void prepare_view(render_t& gc) const;
+
+    void on_scroll(wxScrollWinEvent& event);
+    void on_scroll_wheel(wxMouseEvent& event);
+    void on_size(wxSizeEvent& event);
+
+    struct backbuffer_state_t
+    {
+        int w, h;
+        std::int64_t sx, sy;
+        int scale;
+        std::uint64_t key;
+        auto operator<=>(backbuffer_state_t const&) const = default;
+    };
+
+    wxBitmap backbuffer;
+    wxBitmap scroll_spare; // Swapped with 'backbuffer' on scrolls, as blitting onto itself isn't portable.
+    backbuffer_state_t backbuffer_state = {};
+    bool backbuffer_valid = false;
+
+    rect_t painted_overlay = {};
+    bool motion_pending = false;
+
+    paint_stats_t stats;
+    wxTimer hud_timer;
+    wxRect hud_box = {};
+    wxFont hud_font;
+    wxSize hud_char = { 0, 0 }; // The size of one character in 'hud_font'.
+
+    void draw_hud(render_t& gc);
+    void on_hud_timer(wxTimerEvent& event);
 };
 
 class selector_box_t : public grid_box_t
@@ -282,7 +398,7 @@ public:
     explicit selector_box_t(wxWindow* parent, model_t& model, bool can_zoom = false) 
     : grid_box_t(parent, can_zoom) 
     , model(model)
-    {}
+    { Bind(wxEVT_LEAVE_WINDOW, &selector_box_t::on_leave, this); }
 
     virtual tile_model_t& tiles() const = 0;
     auto& layer() const { return tiles().layer(); }
@@ -299,15 +415,50 @@ protected:
 
     coord_t mouse_start = {};
 
+    // What this box last wrote to the status bar, to skip formatting it again while hovering the same tile.
+    // Every box shares the status bar, so it's rewritten when anything else replaced the text too.
+    coord_t status_at = { -1, -1 };
+    int status_value = -1;
+    wxString status_text;
+    bool status_valid = false;
+
+    bool status_changed(coord_t at, int value)
+    {
+        if(status_valid && at == status_at && value == status_value && model.status_bar->GetStatusText() == status_text)
+            return false;
+        status_at = at;
+        status_value = value;
+        return true;
+    }
+
+    void set_status(char const* text)
+    {
+        status_text = text;
+        status_valid = true;
+        model.status_bar->SetStatusText(status_text);
+    }
+
+    void on_leave(wxMouseEvent& event)
+    {
+        status_valid = false;
+        event.Skip();
+    }
+
     void on_draw(render_t& gc) override;
 
     virtual void on_down(mouse_button_t mb, coord_t at) override { mouse_start = at; }
     virtual void on_up(mouse_button_t mb, coord_t mouse_end) override;
     virtual void on_motion(coord_t at) override;
     virtual int tile_value(coord_t at) { return tiles().layer().to_tile(at); }
+    virtual rect_t overlay_rect() const override;
 
     virtual void draw_tile(render_t& gc, unsigned tile, coord_t at) {}
     virtual void draw_tiles(render_t& gc) override;
+
+    // Every tile of the picker. With a backbuffer, this only reruns when 'backbuffer_key' changes,
+    // leaving just the selection to draw live.
+    void draw_sheet(render_t& gc);
+    virtual void draw_backbuffer(render_t& gc) override { draw_sheet(gc); }
 };
 
 class canvas_box_t : public selector_box_t
@@ -340,6 +491,7 @@ protected:
     virtual void on_motion(coord_t at) override;
     virtual int tile_code(coord_t at) { return at.x + at.y * grid_dimen.w; }
     virtual int tile_value(coord_t at) { return layer().get(at); }
+    virtual rect_t overlay_rect() const override;
 
     virtual void draw_tile(render_t& gc, unsigned tile, coord_t at) {}
     virtual void draw_tiles(render_t& gc) override;
@@ -400,6 +552,7 @@ public:
     }
 
     page_type& page(int i) { return *static_cast<page_type*>(notebook->GetPage(i)); }
+    unsigned page_count() const { return notebook->GetPageCount(); }
 
     page_type* page()
     {
@@ -28,13 +28,17 @@ enum
     ID_FILL,
     ID_FILL_PASTE,
     ID_FILL_ATTRIBUTE,
+    ID_REPLACE_TILES,
     ID_TOOL_STAMP,
     ID_TOOL_DROPPER,
     ID_TOOL_SELECT,
+    ID_TOOL_BUCKET,
     ID_DELETE_OBJ,
     ID_MANAGE_TABS,
     ID_SHOW_COLLISIONS,
     ID_LEVEL_GRID,
+    ID_SOFTWARE_RENDER,
+    ID_SHOW_HUD,
     ID_SELECT_ALL,
     ID_SELECT_NONE,
     ID_SELECT_USAGE,
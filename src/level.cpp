@@ -1,25 +1,62 @@
 #include "level.hpp"
 
+#include <cmath>
+#include <map>
+#include <numbers>
 #include <ranges>
+#include <string_view>
 
-void draw_chr_tile(level_model_t const& model, render_t& gc, std::uint16_t id, std::uint16_t tile, std::uint8_t attribute, coord_t at)
+#include "minimap.hpp"
+
+bitmap_t const* prescaled_chr_t::get(render_t& gc, level_model_t const& model, std::uint16_t id, std::uint16_t tile, std::uint8_t attribute, int zoom)
 {
-    auto const it = model.chr_bitmaps.find(id);
+    zoom = std::max(zoom, 1);
+    if(model.chr_generation != chr_generation || zoom != this->zoom)
+    {
+        bitmaps.clear();
+        used.clear();
+        chr_generation = model.chr_generation;
+        this->zoom = zoom;
+    }
 
-    if(it == model.chr_bitmaps.end())
-        goto fail;
+    std::uint64_t const key = (std::uint64_t(id) << 32) | (std::uint64_t(attribute) << 16) | tile;
+    if(auto const it = bitmaps.find(key); it != bitmaps.end())
+    {
+        used.splice(used.begin(), used, it->second.used);
+        return &it->second.bitmap;
+    }
 
-    if(tile < it->second.size() && attribute < 4)
+    auto const it = model.chr_planes.find(id);
+    if(it == model.chr_planes.end() || attribute >= 4)
+        return nullptr;
+    chr_planes_t const& planes = *it->second;
+    if(tile >= planes.size() || planes.bad[tile])
+        return nullptr;
+
+    // Nearest-neighbor scaling is just the compositor at 'zoom':
+    int const span = 8 * zoom;
+    wxImage image(span, span, false);
+    compose_tile_t const source = { planes.tile(tile), &model.chr_lut[attribute] };
+    compose_tile_row({ reinterpret_cast<rgb_t*>(image.GetData()), span, { span, span } }, { 0, 0 }, zoom, &source, 1);
+
+    std::size_t const max_tiles = std::max<std::size_t>(MAX_BYTES / (span * span * 4), 1);
+    while(bitmaps.size() >= max_tiles)
     {
-#if GC_RENDER
-        gc.DrawBitmap(it->second[tile][attribute], at.x, at.y, 8, 8);
-#else
-        gc.DrawBitmap(it->second[tile][attribute], { at.x, at.y });
-#endif
+        bitmaps.erase(used.back());
+        used.pop_back();
     }
+
+    used.push_front(key);
+    return &bitmaps.emplace(key, entry_t{ make_bitmap(gc, image), used.begin() }).first->second.bitmap;
+}
+
+void draw_chr_tile(level_model_t const& model, render_t& gc, std::uint16_t id, std::uint16_t tile, std::uint8_t attribute, coord_t at,
+                   prescaled_chr_t& prescaled, int zoom)
+{
+    if(bitmap_t const* bitmap = prescaled.get(gc, model, id, tile, attribute, zoom))
+        draw_prescaled(gc, *bitmap, wxSize(8 * zoom, 8 * zoom), at.x, at.y, zoom);
     else
     {
-    fail:
 #if GC_RENDER
         gc.DrawBitmap(model.bad_chr, at.x, at.y, 8, 8);
 #else
@@ -38,6 +75,63 @@ void draw_collision_tile(model_t const& model, render_t& gc, std::uint8_t tile,
 #endif
 }
 
+// Renders an anti-aliased, outlined circle into an image with alpha, centered on the middle pixel.
+static wxImage circle_image(double radius, wxColour const& fill, wxColour const& pen, bool dotted, bool center_dot)
+{
+    int const half = int(std::ceil(radius)) + 1;
+    int const size = half * 2 + 1;
+
+    wxImage image(size, size);
+    image.InitAlpha();
+    unsigned char* rgb = image.GetData();
+    unsigned char* alpha = image.GetAlpha();
+
+    for(int y = 0; y < size; ++y)
+    for(int x = 0; x < size; ++x)
+    {
+        double const dx = x - half;
+        double const dy = y - half;
+        double const d = std::sqrt(dx*dx + dy*dy);
+
+        // Premultiplied:
+        double r = 0, g = 0, b = 0, a = 0;
+        auto const over = [&](wxColour const& color, double coverage)
+        {
+            double const ca = color.Alpha() / 255.0 * std::clamp(coverage, 0.0, 1.0);
+            r = color.Red()   * ca + r * (1.0 - ca);
+            g = color.Green() * ca + g * (1.0 - ca);
+            b = color.Blue()  * ca + b * (1.0 - ca);
+            a = ca + a * (1.0 - ca);
+        };
+
+        over(fill, radius - d + 0.5);
+
+        double ring = 1.0 - std::abs(d - radius);
+        if(dotted && (int(std::floor((std::atan2(dy, dx) + std::numbers::pi) * radius / 2.0)) & 1))
+            ring = 0.0;
+        over(pen, ring);
+
+        if(center_dot && x == half && y == half)
+            over(pen, 1.0);
+
+        unsigned const i = x + y * size;
+        alpha[i] = a * 255.0 + 0.5;
+        rgb[i*3+0] = a > 0.0 ? r / a + 0.5 : 0;
+        rgb[i*3+1] = a > 0.0 ? g / a + 0.5 : 0;
+        rgb[i*3+2] = a > 0.0 ? b / a + 0.5 : 0;
+    }
+
+    return image;
+}
+
+static void draw_sprite(render_t& gc, bitmap_t const& bitmap, int half, coord_t at)
+{
+#if GC_RENDER
+    gc.DrawBitmap(bitmap, at.x - half, at.y - half, half * 2 + 1, half * 2 + 1);
+#else
+    gc.DrawBitmap(bitmap, { at.x - half, at.y - half });
+#endif
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // object_field_t //////////////////////////////////////////////////////////////
@@ -358,7 +452,21 @@ void chr_picker_t::draw_tile(render_t& gc, std::uint32_t tile, coord_t at)
         draw_collision_tile(model, gc, tile, at);
     }
     else
-        draw_chr_tile(*level, gc, level->chr_id, tile_tile(tile), level->active, at); 
+        draw_chr_tile(*level, gc, level->chr_id, tile_tile(tile), level->active, at, prescaled, scale); 
+}
+
+std::uint64_t chr_picker_t::backbuffer_key() const
+{
+    std::uint64_t key = 0;
+    auto const mix = [&](std::uint64_t v) { key ^= v + 0x9E3779B97F4A7C15ull + (key << 6) + (key >> 2); };
+    mix(level->chr_generation);
+    mix(level->chr_id);
+    mix(level->active);
+    mix(level->collisions());
+    mix(model.collision_generation);
+    mix(selector().dimen().w);
+    mix(selector().dimen().h);
+    return key;
 }
 
 
@@ -366,36 +474,321 @@ void chr_picker_t::draw_tile(render_t& gc, std::uint32_t tile, coord_t at)
 // level_canvas_t //////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-void level_canvas_t::draw_tiles(render_t& gc)
+std::uint64_t level_canvas_t::backbuffer_key() const
+{
+    std::uint64_t key = 0;
+    auto const mix = [&](std::uint64_t v) { key ^= v + 0x9E3779B97F4A7C15ull + (key << 6) + (key >> 2); };
+    mix(level->chr_generation);
+    mix(model.collision_generation);
+    mix(model.collision_scale());
+    mix(level->dimen().w);
+    mix(level->dimen().h);
+    mix(level->collision_layer.tiles.dimen().w);
+    mix(level->collision_layer.tiles.dimen().h);
+    mix(level->collisions() || model.show_collisions);
+    mix(model.show_grid);
+    mix(model.software_render);
+    return key;
+}
+
+bool level_canvas_t::collect_dirty(std::vector<rect_t>& dirty)
 {
-    for(coord_t c : dimen_range(level->chr_layer.tiles.dimen()))
+    dimen_t const collision_size = { 8 * model.collision_scale(), 8 * model.collision_scale() };
+
+    bool const chr_ok = level->chr_layer.for_each_touched(chr_seen, [&](rect_t r)
+    {
+        dirty.push_back(to_screen(r, { 8, 8 }));
+    });
+    bool const collision_ok = level->collision_layer.for_each_touched(collision_seen, [&](rect_t r)
+    {
+        dirty.push_back(to_screen(r, collision_size));
+    });
+
+    chr_seen = level->chr_layer.generation;
+    collision_seen = level->collision_layer.generation;
+    return chr_ok && collision_ok;
+}
+
+using chr_planes_map_t = decltype(level_model_t::chr_planes);
+
+static compose_tile_t chr_compose_tile(chr_planes_map_t const& chr_planes, attr_lut_t const& lut, std::uint32_t tile)
+{
+    auto const it = chr_planes.find(chr_id(tile));
+    if(it == chr_planes.end())
+        return bad_compose_tile();
+    chr_planes_t const& planes = *it->second;
+    if(tile_tile(tile) >= planes.size() || planes.bad[tile_tile(tile)])
+        return bad_compose_tile();
+    return { planes.tile(tile_tile(tile)), &lut[tile_attr(tile)] };
+}
+
+std::uint64_t level_canvas_t::frame_key() const
+{
+    std::uint64_t key = 0;
+    auto const mix = [&](std::uint64_t v) { key ^= v + 0x9E3779B97F4A7C15ull + (key << 6) + (key >> 2); };
+    mix(level->chr_generation);
+    mix(scale);
+    mix(level->dimen().w);
+    mix(level->dimen().h);
+    return key;
+}
+
+rect_t level_canvas_t::frame_bounds() const
+{
+    return to_rect(dimen_t{ level->dimen().w * 8 * scale, level->dimen().h * 8 * scale });
+}
+
+rect_t level_canvas_t::frame_view() const
+{
+    wxSize const size = GetClientSize();
+    coord_t const c = { int(view_x - margin().w * scale), int(view_y - margin().h * scale) };
+    return crop(rect_t{ c, dimen_t{ size.x, size.y } }, frame_bounds().d);
+}
+
+bool level_canvas_t::patch_frame(compose_frame_t& f)
+{
+    if(f.key != frame_key())
+        return false;
+
+    // Recompose whatever was edited since the frame's snapshot:
+    bool const complete = level->chr_layer.for_each_touched(f.generation, [&](rect_t tiles)
+    {
+        int const span = 8 * scale;
+        rect_t const r = overlap_rect({ coord_t{ tiles.c.x * span, tiles.c.y * span }, dimen_t{ tiles.d.w * span, tiles.d.h * span } }, f.rect);
+        if(!r)
+            return;
+        compose_tiles(f.target(r), { -r.c.x, -r.c.y }, level->dimen(), scale, [&](coord_t c)
+        {
+            return chr_compose_tile(level->chr_planes, level->chr_lut, level->chr_layer.tiles.at(c));
+        });
+    });
+
+    if(!complete)
+        return false;
+    f.generation = level->chr_layer.generation;
+    return true;
+}
+
+void level_canvas_t::request_frame()
+{
+    rect_t const view = frame_view();
+    std::uint64_t const key = frame_key();
+
+    if(frame_pending && frame_requested_key == key && rect_covers(frame_requested, view))
+        return;
+
+    // Speculatively compose a margin around the view, so that scrolling a little doesn't need a new frame:
+    rect_t const rect = crop(rect_t{ coord_t{ view.c.x - FRAME_MARGIN, view.c.y - FRAME_MARGIN }, 
+                                     dimen_t{ view.d.w + FRAME_MARGIN * 2, view.d.h + FRAME_MARGIN * 2 } }, frame_bounds().d);
+    if(!rect)
+        return;
+
+    // Snapshot what the worker needs:
+    int const span = 8 * scale;
+    coord_t const t0 = { rect.c.x / span, rect.c.y / span };
+    coord_t const t1 = { (rect.e().x + span - 1) / span, (rect.e().y + span - 1) / span };
+    dimen_t const tiles_dimen = { t1.x - t0.x, t1.y - t0.y };
+    std::vector<std::uint32_t> tiles;
+    tiles.reserve(tiles_dimen.w * tiles_dimen.h);
+    for(coord_t c : dimen_range(tiles_dimen))
+        tiles.push_back(level->chr_layer.tiles.at(c + t0));
+
+    auto pending = frame_pending = std::make_shared<pending_t<compose_frame_t>>();
+    frame_requested = rect;
+    frame_requested_key = key;
+
+    workers().submit([pending, key, generation = level->chr_layer.generation, rect, zoom = scale, span, t0, tiles_dimen, 
+                      tiles = std::move(tiles), chr_planes = level->chr_planes, lut = level->chr_lut]()
+    {
+        compose_frame_t result = { key, generation, rect };
+        result.pixels.resize(rect.d.w * rect.d.h);
+        compose_target_t const target = { result.pixels.data(), rect.d.w, rect.d };
+
+        // Tile rows write separate pixel rows, so they can be split up:
+        parallel_for(0, tiles_dimen.h, [&](unsigned y)
+        {
+            std::vector<compose_tile_t> row(tiles_dimen.w);
+            for(int x = 0; x < tiles_dimen.w; ++x)
+                row[x] = chr_compose_tile(chr_planes, lut, tiles[x + y * tiles_dimen.w]);
+            coord_t const at = { (t0.x * span) - rect.c.x, (t0.y + int(y)) * span - rect.c.y };
+            compose_tile_row(target, at, zoom, row.data(), row.size());
+        });
+
+        pending->post(std::move(result));
+    });
+}
+
+void level_canvas_t::poll_frame()
+{
+    if(!frame_pending)
+        return;
+
+    std::optional<compose_frame_t> result = frame_pending->take();
+    if(!result)
+        return;
+    frame_pending.reset();
+
+    // Frames the model has moved on from are dropped, unless the edits since can be patched in:
+    if(!patch_frame(*result))
+    {
+        if(frame_missing)
+        {
+            invalidate_backbuffer();
+            Refresh(false);
+        }
+        return;
+    }
+
+    frame = std::move(*result);
+    if(frame_missing)
+    {
+        frame_missing = false;
+        invalidate_backbuffer();
+        Refresh(false);
+    }
+}
+
+void level_canvas_t::on_update()
+{
+    canvas_box_t::on_update();
+    poll_frame();
+}
+
+void level_canvas_t::compose_backbuffer(wxImage& image, coord_t origin)
+{
+    rgb_t* const pixels = reinterpret_cast<rgb_t*>(image.GetData());
+    compose_target_t const target = { pixels, image.GetWidth(), { image.GetWidth(), image.GetHeight() } };
+    coord_t const at = { origin.x + margin().w * scale, origin.y + margin().h * scale };
+
+    // The image's area in frame pixels. Anything beyond the level is left as background.
+    rect_t const area = { coord_t{ -at.x, -at.y }, dimen_t{ image.GetWidth(), image.GetHeight() } };
+    rect_t const needed = crop(area, frame_bounds().d);
+
+    if(frame && !patch_frame(*frame))
+        frame.reset();
+
+    if(frame && frame->covers(needed))
     {
-        int x0 = c.x * 8 + margin().w;
-        int y0 = c.y * 8 + margin().h;
+        if(needed)
+            frame->copy_to(needed, pixels + (needed.c.x - area.c.x) + (needed.c.y - area.c.y) * target.stride, target.stride);
+        if(!frame->covers(frame_view()))
+            request_frame();
+        return;
+    }
 
-        std::uint32_t const tile = level->chr_layer.tiles.at(c);
-        draw_chr_tile(*level, gc, chr_id(tile), tile_tile(tile), tile_attr(tile), { x0, y0 });
+    // Small areas, like edits, are cheap enough to do right here:
+    if(needed.d.w * needed.d.h <= SYNC_COMPOSE_PIXELS)
+    {
+        compose_tiles(target, at, level->dimen(), scale, [&](coord_t c)
+        {
+            counts.tiles += 1;
+            return chr_compose_tile(level->chr_planes, level->chr_lut, level->chr_layer.tiles.at(c));
+        });
+        return;
     }
 
-    for(coord_t c : dimen_range(level->collision_layer.tiles.dimen()))
+    // Otherwise show what's available, and finish it off-thread:
+    if(frame)
+        frame->copy_to(needed, pixels + (needed.c.x - area.c.x) + (needed.c.y - area.c.y) * target.stride, target.stride);
+    frame_missing = true;
+    request_frame();
+}
+
+void level_canvas_t::draw_backbuffer(render_t& gc)
+{
+    // With the compositor, the CHR tiles are already in place.
+    if(!use_compositor())
     {
-        int x0 = c.x * 8 * model.collision_scale() + margin().w;
-        int y0 = c.y * 8 * model.collision_scale() + margin().h;
+        rect_t const visible = visible_tiles({ 8, 8 }, level->chr_layer.tiles.dimen());
+        counts.tiles += visible.d.w * visible.d.h;
 
-        if(level->collisions() || model.show_collisions)
+        for(coord_t c : rect_range(visible))
         {
+            int x0 = c.x * 8 + margin().w;
+            int y0 = c.y * 8 + margin().h;
+
+            std::uint32_t const tile = level->chr_layer.tiles.at(c);
+            draw_chr_tile(*level, gc, chr_id(tile), tile_tile(tile), tile_attr(tile), { x0, y0 }, prescaled, scale);
+        }
+    }
+
+    int const size = 8 * model.collision_scale();
+    rect_t const visible = visible_tiles({ size, size }, level->collision_layer.tiles.dimen());
+
+    if(level->collisions() || model.show_collisions)
+    {
+        counts.tiles += visible.d.w * visible.d.h;
+        for(coord_t c : rect_range(visible))
+        {
+            int x0 = c.x * size + margin().w;
+            int y0 = c.y * size + margin().h;
+
             unsigned const tile = level->collision_layer.tiles.at(c);
             draw_collision_tile(model, gc, tile, { x0, y0 });
         }
+    }
+
+    // The grid is a single set of lines spanning just the visible cells:
+    if(model.show_grid && visible)
+    {
+        int const x0 = visible.c.x * size + margin().w;
+        int const y0 = visible.c.y * size + margin().h;
+        int const x1 = visible.e().x * size + margin().w;
+        int const y1 = visible.e().y * size + margin().h;
 
-        if(model.show_grid)
+        std::vector<wxPoint2DDouble> begins, ends;
+        for(int x = x0; x <= x1; x += size)
+        {
+            begins.emplace_back(x, y0);
+            ends.emplace_back(x, y1);
+        }
+        for(int y = y0; y <= y1; y += size)
         {
-            gc.SetPen(wxPen(wxColor(255, 0, 255), 0, wxPENSTYLE_DOT));
-            gc.SetBrush(wxBrush());
-            gc.DrawRectangle(x0, y0, 8 * model.collision_scale(), 8 * model.collision_scale());
+            begins.emplace_back(x0, y);
+            ends.emplace_back(x1, y);
         }
+
+        counts.rects += begins.size();
+        gc.SetPen(wxPen(wxColor(255, 0, 255), 0, wxPENSTYLE_DOT));
+        stroke_segments(gc, begins, ends);
     }
+}
+
+void level_canvas_t::hud_lines(std::vector<wxString>& lines) const
+{
+    lines.push_back(wxString::Format("refresh_chr %.2f ms", level->chr_refresh_ms));
+}
+
+level_canvas_t::sprite_t const& level_canvas_t::object_sprite(render_t& gc, std::uint32_t key)
+{
+    auto const it = object_sprites.find(key);
+    if(it != object_sprites.end())
+        return it->second;
+
+    bool const selected = key & SPRITE_SELECTED;
+    wxImage image;
 
+    if(key & SPRITE_RING)
+    {
+        if(selected)
+            image = circle_image(object_radius() * 3 / 2, wxColor(255, 255, 255, 255), wxColor(255, 0, 255, 255), false, false);
+        else
+            image = circle_image(object_radius() * 3 / 2, wxColor(255, 255, 255, 200), wxColor(0, 0, 0, 200), false, false);
+    }
+    else if(key & SPRITE_PASTE)
+        image = circle_image(object_radius(), wxColor(255, 255, 0, 200), wxColor(255, 0, 255, 255), false, true);
+    else
+    {
+        wxColor const color((key >> 16) & 0xFF, (key >> 8) & 0xFF, key & 0xFF, selected ? 255 : 200);
+        image = circle_image(object_radius(), color, color, !(key & SPRITE_IN_BOUNDS), true);
+    }
+
+    return object_sprites.emplace(key, sprite_t{ make_bitmap(gc, image), image.GetWidth() / 2 }).first->second;
+}
+
+void level_canvas_t::draw_tiles(render_t& gc)
+{
+    // The tiles, collisions and grid come from the backbuffer.
     draw_overlays(gc);
 
     bool const object_select = 
@@ -406,6 +799,11 @@ void level_canvas_t::draw_tiles(render_t& gc)
     gc.SetPen(wxPen(wxColor(255, 0, 255), 0, wxPENSTYLE_DOT));
     gc.SetBrush(wxBrush());
 
+    // Objects are drawn at a fixed screen size, so pad the paint area by their radius:
+    int const pad = object_radius() * 3 / 2 / scale + 2;
+    rect_t const object_rect = { paint_rect.c - coord_t{ pad, pad }, dimen_t{ paint_rect.d.w + pad*2, paint_rect.d.h + pad*2 } };
+    auto const object_visible = [&](coord_t at) { return in_bounds(at - object_rect.c, object_rect.d); };
+
     // Objects:
 #ifdef GC_RENDER
     gc.Scale(1.0f / scale, 1.0f / scale);
@@ -413,67 +811,65 @@ void level_canvas_t::draw_tiles(render_t& gc)
     gc.SetLogicalScale(1.0f / scale, 1.0f / scale);
 #endif
 
-    for(unsigned i = 0; i < level->objects.size(); ++i)
+    std::unordered_map<std::string_view, rgb_t> class_colors;
+    for(auto const& ptr : model.object_classes)
+        class_colors.emplace(ptr->name, ptr->color);
+
+    // The visible objects and their sprite keys, in index order so that overlaps stack as before:
+    struct visible_object_t
     {
-        auto const& object = level->objects[i];
-        coord_t const at = vec_mul(crop(object.position) + to_coord(margin()), scale);
+        coord_t at;
+        std::uint32_t key;
+    };
 
-        if(level->object_selector.count(i))
-        {
-            gc.SetPen(wxPen(wxColor(255, 0, 255, 255), 0, wxPENSTYLE_SOLID));
-            gc.SetBrush(wxBrush(wxColor(255, 255, 255, 255)));
-        }
-        else
-        {
-            gc.SetPen(wxPen(wxColor(0, 0, 0, 200), 0, wxPENSTYLE_SOLID));
-            gc.SetBrush(wxBrush(wxColor(255, 255, 255, 200)));
-        }
-        draw_circle(gc, at.x, at.y, object_radius() * 3 / 2);
-    }
+    dimen_t const level_pixels = vec_mul(level->chr_layer.tiles.dimen(), 8);
+    std::vector<visible_object_t> visible;
 
     for(unsigned i = 0; i < level->objects.size(); ++i)
     {
         auto const& object = level->objects[i];
-
-        auto style = wxPENSTYLE_SOLID;
-        if(!in_bounds(object.position, vec_mul(level->chr_layer.tiles.dimen(), 8)))
-            style = wxPENSTYLE_DOT;
+        if(!object_visible(crop(object.position) + to_coord(margin())))
+            continue;
+        coord_t const at = vec_mul(crop(object.position) + to_coord(margin()), scale);
 
         rgb_t color = { 120, 120, 120 };
+        auto const it = class_colors.find(object.oclass);
+        if(it != class_colors.end())
+            color = it->second;
 
-        for(auto const& ptr : model.object_classes)
-        {
-            if(ptr->name == object.oclass)
-            {
-                color = ptr->color;
-                break;
-            }
-        }
-
+        std::uint32_t key = (color.r << 16) | (color.g << 8) | color.b;
         if(level->object_selector.count(i))
-        {
-            gc.SetPen(wxPen(wxColor(color.r, color.g, color.b), 0, style));
-            gc.SetBrush(wxBrush(wxColor(color.r, color.g, color.b, 255)));
-        }
-        else
-        {
-            gc.SetPen(wxPen(wxColor(color.r, color.g, color.b, 200), 0, style));
-            gc.SetBrush(wxBrush(wxColor(color.r, color.g, color.b, 200)));
-        }
+            key |= SPRITE_SELECTED;
+        if(in_bounds(object.position, level_pixels))
+            key |= SPRITE_IN_BOUNDS;
 
-        coord_t const at = vec_mul(crop(object.position) + to_coord(margin()), scale);
-        draw_circle(gc, at.x, at.y, object_radius());
-        draw_point(gc, at.x, at.y);
+        visible.push_back({ at, key });
+        counts.objects += 1;
     }
 
+    // Neighboring objects tend to look alike, so the last sprite is reused rather than looked up again:
+    std::uint32_t last_key = ~0u;
+    sprite_t const* sprite = nullptr;
+    auto const draw = [&](coord_t at, std::uint32_t key)
+    {
+        if(key != last_key)
+            sprite = &object_sprite(gc, last_key = key);
+        draw_sprite(gc, sprite->bitmap, sprite->half, at);
+    };
+
+    // Every ring goes below every core:
+    for(visible_object_t const& object : visible)
+        draw(object.at, SPRITE_RING | (object.key & SPRITE_SELECTED));
+    for(visible_object_t const& object : visible)
+        draw(object.at, object.key);
+
     if(level->current_layer == OBJECT_LAYER)
     {
         if(model.paste && model.paste->format == LAYER_OBJECTS)
         {
             if(auto const* objects = std::get_if<std::vector<object_t>>(&model.paste->data))
             {
-                gc.SetPen(wxPen(wxColor(255, 0, 255, 255), 0, wxPENSTYLE_SOLID));
-                gc.SetBrush(wxBrush(wxColor(255, 255, 0, 200)));
+                sprite_t const& sprite = object_sprite(gc, SPRITE_PASTE);
 
                 for(auto const& object : *objects)
                 {
@@ -481,10 +877,9 @@ void level_canvas_t::draw_tiles(render_t& gc)
                     position += from_screen(mouse_current, {1,1});
                     position.x += margin().w;
                     position.y += margin().h;
-                    position = vec_mul(position, scale);
-
-                    draw_circle(gc, position.x, position.y, object_radius());
-                    draw_point(gc, position.x, position.y);
+                    if(!object_visible(position))
+                        continue;
+                    draw_sprite(gc, sprite.bitmap, sprite.half, vec_mul(position, scale));
                 }
             }
         }
@@ -763,6 +1158,32 @@ void level_canvas_t::on_motion(coord_t at)
         canvas_box_t::on_motion(at);
 }
 
+rect_t level_canvas_t::overlay_rect() const
+{
+    if(level->current_layer != OBJECT_LAYER)
+        return canvas_box_t::overlay_rect();
+
+    rect_t ret = {};
+    auto const add = [&](rect_t r) { ret = ret ? grow_rect_to_contain(ret, r) : r; };
+
+    if(selecting_objects && mouse_down && model.tool == TOOL_SELECT)
+        add(to_screen(rect_from_2_coords(from_screen(object_select_start, {1,1}), from_screen(mouse_current, {1,1})), {1,1}));
+
+    if(model.paste && model.paste->format == LAYER_OBJECTS)
+    {
+        if(auto const* objects = std::get_if<std::vector<object_t>>(&model.paste->data))
+        {
+            // Objects are drawn at a fixed screen size:
+            int const pad = object_radius() / scale + 2;
+            coord_t const pen = from_screen(mouse_current, {1,1}) + to_coord(margin());
+            for(auto const& object : *objects)
+                add({ object.position + pen - coord_t{ pad, pad }, dimen_t{ pad * 2, pad * 2 } });
+        }
+    }
+
+    return ret;
+}
+
 void level_canvas_t::on_dropper(std::uint32_t value)
 {
     level_editor_t* parent = static_cast<level_editor_t*>(GetParent());
@@ -843,6 +1264,7 @@ level_editor_t::level_editor_t(wxWindow* parent, model_t& model, std::shared_ptr
     layers[5] = new wxRadioButton(left_panel, wxID_ANY, "Objects       (F6)");
 
     canvas = new level_canvas_t(this, model, level);
+    minimap = new minimap_t(left_panel, level, *canvas);
 
     {
         wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
@@ -859,6 +1281,7 @@ level_editor_t::level_editor_t(wxWindow* parent, model_t& model, std::shared_ptr
         sizer->Add(dimensions_text, wxSizerFlags().Border(wxLEFT));
         sizer->Add(dimensions_panel, wxSizerFlags().Border(wxLEFT));
         sizer->AddSpacer(8);
+        sizer->Add(minimap, wxSizerFlags().Expand().Border(wxLEFT | wxRIGHT | wxDOWN));
         left_panel->SetSizer(sizer);
     }
 
@@ -950,6 +1373,22 @@ bool level_editor_t::enable_copy()
 
 void level_editor_t::on_update()
 {
+    if(level->poll_chr())
+    {
+        picker->Refresh();
+        canvas->Refresh();
+    }
+
+    minimap->on_update();
+
+    // The unique metatile count, which is what the ROM budget depends on:
+    level->mt_census.update(level->chr_layer, level->collision_layer, model.metatile_size);
+    wxString census;
+    if(model.metatile_size)
+        census.Printf("Metatiles: %u (%+d)", level->mt_census.count(), level->mt_census.delta());
+    if(model.status_bar && IsShownOnScreen() && model.status_bar->GetStatusText(1) != census)
+        model.status_bar->SetStatusText(census, 1);
+
     if(last_palette != level->palette)
         palette_ctrl->SetValue(last_palette = level->palette);
 
@@ -1,6 +1,7 @@
 #ifndef LEVEL_HPP
 #define LEVEL_HPP
 
+#include <list>
 #include <ranges>
 
 #include <wx/wx.h>
@@ -81,7 +82,34 @@ private:
     object_editor_t* editor;
 };
 
-void draw_chr_tile(level_model_t const& model, render_t& gc, std::uint16_t id, std::uint16_t tile, std::uint8_t attribute, coord_t at);
+// CHR tiles rendered at a view's zoom, so magnified views draw them 1:1
+// instead of having the renderer scale every tile.
+// Built lazily, tile by tile, and dropped when the CHR or the zoom changes.
+// As views only build what they draw, a palette change costs the visible tiles rather than every tile.
+// Past its memory budget, the least recently drawn tiles are evicted one at a time.
+class prescaled_chr_t
+{
+public:
+    // Returns null when the tile has no valid CHR.
+    bitmap_t const* get(render_t& gc, level_model_t const& model, std::uint16_t id, std::uint16_t tile, std::uint8_t attribute, int zoom);
+private:
+    // A full screen of distinct tiles is a few megabytes at any zoom, so this holds several.
+    static constexpr std::size_t MAX_BYTES = 64 << 20;
+
+    struct entry_t
+    {
+        bitmap_t bitmap;
+        std::list<std::uint64_t>::iterator used;
+    };
+
+    std::uint64_t chr_generation = ~0ull;
+    int zoom = 0;
+    std::unordered_map<std::uint64_t, entry_t> bitmaps;
+    std::list<std::uint64_t> used; // Keys, most recently drawn first.
+};
+
+void draw_chr_tile(level_model_t const& model, render_t& gc, std::uint16_t id, std::uint16_t tile, std::uint8_t attribute, coord_t at,
+                   prescaled_chr_t& prescaled, int zoom = 1);
 void draw_collision_tile(model_t const& model, render_t& gc, std::uint8_t tile, coord_t at);
 
 class chr_picker_t : public selector_box_t
@@ -94,9 +122,13 @@ public:
 
 private:
     std::shared_ptr<level_model_t> level;
+    prescaled_chr_t prescaled;
 
     virtual tile_model_t& tiles() const override { return *level; }
     virtual void draw_tile(render_t& gc, unsigned tile, coord_t at) override;
+
+    virtual bool use_backbuffer() const override { return true; }
+    virtual std::uint64_t backbuffer_key() const override;
 };
 
 
@@ -110,10 +142,18 @@ public:
 
     virtual void draw_tile(render_t& gc, std::uint32_t tile, coord_t at) override 
     { 
-        draw_chr_tile(*level, gc, chr_id(tile), tile_tile(tile & 0x3FFF), tile_attr(tile), at); 
+        draw_chr_tile(*level, gc, chr_id(tile), tile_tile(tile & 0x3FFF), tile_attr(tile), at, prescaled, scale); 
     }
     virtual void draw_tiles(render_t& gc) override;
 
+    virtual bool use_backbuffer() const override { return true; }
+    virtual std::uint64_t backbuffer_key() const override;
+    virtual bool collect_dirty(std::vector<rect_t>& dirty) override;
+    virtual void draw_backbuffer(render_t& gc) override;
+    virtual bool use_compositor() const override { return model.software_render; }
+    virtual void compose_backbuffer(wxImage& image, coord_t origin) override;
+    virtual void on_update() override;
+
     coord_t crop(coord_t at)
     {
         return ::crop(at, to_rect(vec_mul(level->chr_layer.tiles.dimen(), 16)));
@@ -125,6 +165,8 @@ public:
     virtual void on_up(mouse_button_t mb, coord_t at) override;
     virtual void on_motion(coord_t at) override;
     virtual void on_dropper(std::uint32_t) override;
+    virtual rect_t overlay_rect() const override;
+    virtual void hud_lines(std::vector<wxString>& lines) const override;
 
     virtual bool enable_tile_select() const { return level->current_layer != OBJECT_LAYER; }
 
@@ -134,10 +176,48 @@ private:
     bool selecting_objects = false;
     coord_t drag_last = {};
     coord_t object_select_start = {};
+    std::uint64_t chr_seen = 0;
+    std::uint64_t collision_seen = 0;
+
+    // Objects are drawn from pre-rendered circles, keyed by appearance.
+    static constexpr std::uint32_t SPRITE_SELECTED  = 1 << 24;
+    static constexpr std::uint32_t SPRITE_IN_BOUNDS = 1 << 25;
+    static constexpr std::uint32_t SPRITE_RING      = 1 << 26;
+    static constexpr std::uint32_t SPRITE_PASTE     = 1 << 27;
+
+    struct sprite_t
+    {
+        bitmap_t bitmap;
+        int half; // From the center to each edge.
+    };
+
+    std::unordered_map<std::uint32_t, sprite_t> object_sprites;
+    prescaled_chr_t prescaled;
+
+    // Large areas are composed on the workers, into a frame that paints copy from.
+    static constexpr int FRAME_MARGIN = 256; // Pixels composed beyond the view on each side.
+    static constexpr int SYNC_COMPOSE_PIXELS = 256 * 256; // Areas this small are composed while painting.
+
+    std::optional<compose_frame_t> frame;
+    std::shared_ptr<pending_t<compose_frame_t>> frame_pending;
+    rect_t frame_requested = {};
+    std::uint64_t frame_requested_key = 0;
+    bool frame_missing = false; // Set when a paint went without.
+
+    std::uint64_t frame_key() const;
+    rect_t frame_bounds() const;
+    rect_t frame_view() const;
+    bool patch_frame(compose_frame_t& frame);
+    void request_frame();
+    void poll_frame();
+
+    sprite_t const& object_sprite(render_t& gc, std::uint32_t key);
 
     virtual tile_model_t& tiles() const override { return *level; }
 };
 
+class minimap_t;
+
 class level_editor_t : public editor_t
 {
 friend class level_canvas_t;
@@ -157,6 +237,7 @@ private:
 
     chr_picker_t* picker;
     level_canvas_t* canvas;
+    minimap_t* minimap;
     wxSpinCtrl* palette_ctrl;
     wxSpinCtrl* width_ctrl;
     wxSpinCtrl* height_ctrl;
@@ -15,6 +15,7 @@
 #include "stamp.png.inc"
 #include "dropper.png.inc"
 #include "select.png.inc"
+#include "bucket.png.inc"
 
 #include "model.hpp"
 #include "convert.hpp"
@@ -125,6 +126,136 @@ private:
     }
 };
 
+class replace_dialog_t : public wxDialog
+{
+public:
+    explicit replace_dialog_t(wxWindow* parent)
+    : wxDialog(parent, wxID_ANY, "Find and Replace Tiles")
+    {
+        wxBoxSizer* main_sizer = new wxBoxSizer(wxVERTICAL);
+
+        wxStaticText* label = new wxStaticText(this, wxID_ANY, "Replaces matching CHR tiles in every level. Keep every field to only count matches.");
+        main_sizer->Add(label, 0, wxALL, 2);
+        main_sizer->AddSpacer(8);
+
+        wxPanel* panel = new wxPanel(this);
+        {
+            wxFlexGridSizer* sizer = new wxFlexGridSizer(5, wxSize(8, 2));
+            sizer->AddSpacer(0);
+            sizer->Add(new wxStaticText(panel, wxID_ANY, "Find"));
+            sizer->AddSpacer(0);
+            sizer->Add(new wxStaticText(panel, wxID_ANY, "Replace"));
+            sizer->AddSpacer(0);
+
+            for(unsigned i = 0; i < fields.size(); ++i)
+            {
+                field_t const& field = fields[i];
+                sizer->Add(new wxStaticText(panel, wxID_ANY, field.name), 0, wxALIGN_CENTER_VERTICAL);
+                find_ctrl[i] = new wxSpinCtrl(panel);
+                find_ctrl[i]->SetRange(0, field.max);
+                sizer->Add(find_ctrl[i]);
+                find_any[i] = new wxCheckBox(panel, wxID_ANY, "Any");
+                find_any[i]->SetValue(i != TILE_FIELD);
+                sizer->Add(find_any[i], 0, wxALIGN_CENTER_VERTICAL);
+                replace_ctrl[i] = new wxSpinCtrl(panel);
+                replace_ctrl[i]->SetRange(0, field.max);
+                sizer->Add(replace_ctrl[i]);
+                replace_keep[i] = new wxCheckBox(panel, wxID_ANY, "Keep");
+                replace_keep[i]->SetValue(i != TILE_FIELD);
+                sizer->Add(replace_keep[i], 0, wxALIGN_CENTER_VERTICAL);
+            }
+
+            panel->SetSizer(sizer);
+        }
+        main_sizer->Add(panel, 0, wxALL, 2);
+        main_sizer->AddSpacer(8);
+
+        wxString const scopes[] = { "Whole Levels", "Region", "Selection" };
+        scope_ctrl = new wxRadioBox(this, wxID_ANY, "Search", wxDefaultPosition, wxDefaultSize, 3, scopes);
+        main_sizer->Add(scope_ctrl, 0, wxALL | wxEXPAND, 2);
+
+        wxPanel* region_panel = new wxPanel(this);
+        {
+            wxBoxSizer* sizer = new wxBoxSizer(wxHORIZONTAL);
+            char const* const names[] = { "X:", "Y:", "Width:", "Height:" };
+            for(unsigned i = 0; i < 4; ++i)
+            {
+                region_ctrl[i] = new wxSpinCtrl(region_panel);
+                region_ctrl[i]->SetRange(0, 1 << 16);
+                region_ctrl[i]->SetValue(i < 2 ? 0 : 16);
+                sizer->Add(new wxStaticText(region_panel, wxID_ANY, names[i]), 0, wxALL | wxCENTER, 2);
+                sizer->Add(region_ctrl[i], 0, wxALL | wxCENTER, 2);
+            }
+            region_panel->SetSizer(sizer);
+        }
+        main_sizer->Add(region_panel, 0, wxALL, 2);
+        main_sizer->AddSpacer(8);
+
+        wxPanel* button_panel = new wxPanel(this);
+        {
+            wxBoxSizer* sizer = new wxBoxSizer(wxHORIZONTAL);
+
+            wxButton* ok_button = new wxButton(button_panel, wxID_OK, "Replace");
+            sizer->Add(ok_button, 0, wxALL | wxALIGN_CENTER, 2);
+            sizer->AddSpacer(16);
+            wxButton* cancel_button = new wxButton(button_panel, wxID_CANCEL, "Cancel");
+            sizer->Add(cancel_button, 0, wxALL | wxALIGN_CENTER, 2);
+
+            button_panel->SetSizer(sizer);
+        }
+        main_sizer->Add(button_panel, 0, wxALL | wxALIGN_CENTER, 2);
+
+        SetSizerAndFit(main_sizer);
+    }
+
+    tile_replace_t replace() const
+    {
+        tile_replace_t ret;
+        for(unsigned i = 0; i < fields.size(); ++i)
+        {
+            field_t const& field = fields[i];
+            if(!find_any[i]->GetValue())
+            {
+                ret.find |= std::uint32_t(find_ctrl[i]->GetValue()) << field.shift;
+                ret.find_mask |= field.mask;
+            }
+            if(!replace_keep[i]->GetValue())
+            {
+                ret.replace |= std::uint32_t(replace_ctrl[i]->GetValue()) << field.shift;
+                ret.replace_mask |= field.mask;
+            }
+        }
+        ret.scope = tile_replace_t::scope_t(scope_ctrl->GetSelection());
+        ret.region = { coord_t{ region_ctrl[0]->GetValue(), region_ctrl[1]->GetValue() }, 
+                       dimen_t{ region_ctrl[2]->GetValue(), region_ctrl[3]->GetValue() } };
+        return ret;
+    }
+
+private:
+    struct field_t
+    {
+        char const* name;
+        int max;
+        unsigned shift;
+        std::uint32_t mask;
+    };
+
+    static constexpr unsigned TILE_FIELD = 1;
+    static constexpr std::array<field_t, 3> fields =
+    {{
+        { "CHR ID",    0xFFFF, 16, 0xFFFF0000 },
+        { "Tile",      0x3FFF, 0,  0x3FFF },
+        { "Attribute", 3,      14, 0xC000 },
+    }};
+
+    std::array<wxSpinCtrl*, 3> find_ctrl;
+    std::array<wxCheckBox*, 3> find_any;
+    std::array<wxSpinCtrl*, 3> replace_ctrl;
+    std::array<wxCheckBox*, 3> replace_keep;
+    std::array<wxSpinCtrl*, 4> region_ctrl;
+    wxRadioBox* scope_ctrl;
+};
+
 class app_t: public wxApp
 {
     bool OnInit();
@@ -206,6 +337,7 @@ private:
             fill->Enable(can_fill);
             fill_paste->Enable(can_fill && can_paste);
             fill_attribute->Enable(can_fill && notebook->GetSelection() == TAB_LEVELS);
+            replace_tiles->Enable(notebook->GetSelection() == TAB_LEVELS);
             select_all->Enable(true);
             select_none->Enable(true);
             select_invert->Enable(true);
@@ -218,6 +350,7 @@ private:
             fill->Enable(false);
             fill_paste->Enable(false);
             fill_attribute->Enable(false);
+            replace_tiles->Enable(false);
             select_all->Enable(false);
             select_none->Enable(false);
             select_invert->Enable(false);
@@ -244,6 +377,8 @@ private:
 
     void update_ui(wxUpdateUIEvent& event)
     {
+        if(model.poll_chr())
+            refresh_tab();
         refresh_title();
         refresh_menus();
     }
@@ -257,22 +392,12 @@ private:
             try
             {
                 if(std::filesystem::exists(model.collision_path))
-                {
-                    auto bm = load_collision_file(model.collision_path.string(), model.collision_scale());
-                    model.collision_bitmaps = std::move(bm.first);
-                    model.collision_wx_bitmaps = std::move(bm.second);
-                }
+                    model.load_collisions();
             }
             catch(...) {}
 
             for(auto& chr : model.chr_files)
-            {
-                try
-                {
-                    chr.load();
-                }
-                catch(...) {}
-            }
+                chr.load_async();
 
             refresh_tab();
         }
@@ -419,6 +544,64 @@ private:
         }
     }
 
+    void on_replace_tiles(wxCommandEvent& event)
+    {
+        replace_dialog_t dialog(this);
+        if(dialog.ShowModal() != wxID_OK)
+            return;
+
+        tile_replace_t const replace = dialog.replace();
+
+        // Each level's undo goes to its own editor, so levels without one can't be undone.
+        auto const editor_of = [&](level_model_t const* level) -> level_editor_t*
+        {
+            for(unsigned i = 0; i < levels_panel->page_count(); ++i)
+                if(levels_panel->page(i).ptr() == level)
+                    return &levels_panel->page(i);
+            return nullptr;
+        };
+
+        // Count first, to ask before changing anything that can't be undone:
+        if(replace.replace_mask)
+        {
+            tile_replace_t count = replace;
+            count.replace_mask = 0;
+            tile_replace_result_t const preview = model.replace_tiles(count);
+
+            unsigned unrecorded = 0;
+            for(level_model_t const* level : preview.matched)
+                unrecorded += !editor_of(level);
+
+            if(unrecorded)
+            {
+                wxString text = wxString::Format("%u of the %u levels with matches have no open tab, "
+                                                 "so their changes can't be undone.\nReplace anyway?", unrecorded, preview.levels);
+                wxMessageDialog confirm(this, text, "Find and Replace Tiles", wxOK | wxCANCEL | wxICON_WARNING);
+                if(confirm.ShowModal() != wxID_OK)
+                    return;
+            }
+        }
+
+        tile_replace_result_t result = model.replace_tiles(replace);
+        if(!result.undos.empty())
+            model.modify();
+
+        for(undo_tiles_t& undo : result.undos)
+        {
+            for(level_model_t* level : result.matched)
+            {
+                if(&level->chr_layer != undo.layer)
+                    continue;
+                if(level_editor_t* editor = editor_of(level))
+                    editor->history.push(std::move(undo));
+                break;
+            }
+        }
+        levels_panel->Refresh();
+
+        wxMessageBox(wxString::Format("%zu tiles matched in %u levels.", result.matches, result.levels), "Find and Replace Tiles");
+    }
+
     void enable_select()
     {
         model.tool = TOOL_SELECT;
@@ -472,6 +655,18 @@ private:
         levels_panel->Refresh();
     }
 
+    void on_software_render(wxCommandEvent& event)
+    {
+        model.software_render = event.IsChecked();
+        levels_panel->Refresh();
+    }
+
+    void on_show_hud(wxCommandEvent& event)
+    {
+        grid_box_t::show_hud = event.IsChecked();
+        Refresh();
+    }
+
     base_tab_panel_t* get_tab_panel()
     {
         switch(notebook->GetSelection())
@@ -508,10 +703,13 @@ private:
     wxMenuItem* fill;
     wxMenuItem* fill_paste;
     wxMenuItem* fill_attribute;
+    wxMenuItem* replace_tiles;
     std::array<wxMenuItem*, 5> zoom;
     wxMenuItem* manage;
     wxMenuItem* show_collisions;
     wxMenuItem* level_grid;
+    wxMenuItem* software_render;
+    wxMenuItem* show_hud;
     wxMenuItem* select_all;
     wxMenuItem* select_none;
     wxMenuItem* select_invert;
@@ -553,6 +751,7 @@ frame_t::frame_t()
     fill = menu_edit->Append(ID_FILL, "Fill Selection\tCTRL+F");
     fill_paste = menu_edit->Append(ID_FILL_PASTE, "Fill Selection with Paste\tCTRL+SHIFT+F");
     fill_attribute = menu_edit->Append(ID_FILL_ATTRIBUTE, "Fill Selection with Attribute\tCTRL+D");
+    replace_tiles = menu_edit->Append(ID_REPLACE_TILES, "Find and &Replace Tiles\tCTRL+H");
     menu_edit->AppendSeparator();
     select_all = menu_edit->Append(ID_SELECT_ALL, "Select All\tCTRL+A");
     select_none = menu_edit->Append(ID_SELECT_NONE, "Select None\tCTRL+SHIFT+A");
@@ -564,6 +763,9 @@ frame_t::frame_t()
     menu_view->AppendSeparator();
     show_collisions = menu_view->Append(ID_SHOW_COLLISIONS, "&Toggle Collisions\tALT+C");
     level_grid = menu_view->Append(ID_LEVEL_GRID, "&Toggle Level Grid\tALT+G");
+    software_render = menu_view->AppendCheckItem(ID_SOFTWARE_RENDER, "&Software Rendering");
+    software_render->Check(model.software_render);
+    show_hud = menu_view->AppendCheckItem(ID_SHOW_HUD, "Performance &Overlay\tCTRL+SHIFT+P");
     menu_view->AppendSeparator();
     zoom[0] = menu_view->Append(ID_ZOOM_100,  "&Zoom 1x");
     zoom[1] = menu_view->Append(ID_ZOOM_200,  "&Zoom 2x");
@@ -583,7 +785,9 @@ frame_t::frame_t()
 
     SetMenuBar(menu_bar);
  
-    model.status_bar = CreateStatusBar();
+    model.status_bar = CreateStatusBar(2);
+    int const status_widths[] = { -1, 200 };
+    model.status_bar->SetStatusWidths(2, status_widths);
 
     auto const make_bitmap = [&](char const* name, unsigned char const* data, std::size_t size)
     {
@@ -600,6 +804,7 @@ frame_t::frame_t()
     tools.push_back(tool_bar->AddRadioTool(ID_TOOL_STAMP, "Stamp", MAKE_BITMAP(src_img_stamp_png)));
     tools.push_back(tool_bar->AddRadioTool(ID_TOOL_DROPPER, "Dropper", MAKE_BITMAP(src_img_dropper_png)));
     tools.push_back(tool_bar->AddRadioTool(ID_TOOL_SELECT, "Select", MAKE_BITMAP(src_img_select_png)));
+    tools.push_back(tool_bar->AddRadioTool(ID_TOOL_BUCKET, "Bucket", MAKE_BITMAP(src_img_bucket_png)));
     tool_bar->Realize();
 
     notebook = new wxNotebook(this, wxID_ANY, wxDefaultPosition, wxSize(600, 300));
@@ -613,6 +818,15 @@ frame_t::frame_t()
     levels_panel = new levels_panel_t(notebook, model);
     notebook->AddPage(levels_panel, wxT("Levels"));
 
+    chr_editor->remap_level_tiles = [this](std::function<void(std::uint32_t&)> const& remap)
+    {
+        for(unsigned i = 0; i < levels_panel->page_count(); ++i)
+        {
+            level_editor_t& page = levels_panel->page(i);
+            page.history.for_each_tile(&page.ptr()->chr_layer, remap);
+        }
+    };
+
     class_panel = new class_panel_t(notebook, model);
     notebook->AddPage(class_panel, wxT("Object Classes"));
 
@@ -637,6 +851,7 @@ frame_t::frame_t()
     Bind(wxEVT_MENU, &frame_t::on_fill, this, ID_FILL);
     Bind(wxEVT_MENU, &frame_t::on_fill_paste, this, ID_FILL_PASTE);
     Bind(wxEVT_MENU, &frame_t::on_fill_attribute, this, ID_FILL_ATTRIBUTE);
+    Bind(wxEVT_MENU, &frame_t::on_replace_tiles, this, ID_REPLACE_TILES);
     Bind(wxEVT_MENU, &frame_t::on_zoom<0>, this, ID_ZOOM_100);
     Bind(wxEVT_MENU, &frame_t::on_zoom<1>, this, ID_ZOOM_200);
     Bind(wxEVT_MENU, &frame_t::on_zoom<2>, this, ID_ZOOM_400);
@@ -649,10 +864,13 @@ frame_t::frame_t()
     Bind(wxEVT_MENU, &frame_t::on_select_invert, this, ID_SELECT_INVERT);
     Bind(wxEVT_MENU, &frame_t::on_select_usage, this, ID_SELECT_USAGE);
     Bind(wxEVT_MENU, &frame_t::on_level_grid, this, ID_LEVEL_GRID);
+    Bind(wxEVT_MENU, &frame_t::on_software_render, this, ID_SOFTWARE_RENDER);
+    Bind(wxEVT_MENU, &frame_t::on_show_hud, this, ID_SHOW_HUD);
 
     Bind(wxEVT_TOOL, &frame_t::on_tool<TOOL_STAMP>, this, ID_TOOL_STAMP);
     Bind(wxEVT_TOOL, &frame_t::on_tool<TOOL_DROPPER>, this, ID_TOOL_DROPPER);
     Bind(wxEVT_TOOL, &frame_t::on_tool<TOOL_SELECT>, this, ID_TOOL_SELECT);
+    Bind(wxEVT_TOOL, &frame_t::on_tool<TOOL_BUCKET>, this, ID_TOOL_BUCKET);
 
     Bind(wxEVT_CLOSE_WINDOW, &frame_t::on_close, this);
     Bind(wxEVT_FSWATCHER, &frame_t::on_watcher, this);
@@ -819,6 +1037,7 @@ void frame_t::refresh_title()
 void frame_t::on_tab_change(wxNotebookEvent& event)
 {
     model.status_bar->SetStatusText("");
+    model.status_bar->SetStatusText("", 1); // The level tab sets its metatile count again when shown.
     if(event.GetOldSelection() == TAB_CHR)
         reset_watcher();
     refresh_tab(event.GetSelection());
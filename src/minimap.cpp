@@ -0,0 +1,187 @@
+#include "minimap.hpp"
+
+#include <cassert>
+#include <algorithm>
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////
+// level_pyramid_t /////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+void level_pyramid_t::rebuild(level_model_t const& level)
+{
+    mips.clear();
+
+    dimen_t d = level.dimen();
+    mips.push_back({ d, std::vector<rgb_t>(d.w * d.h) });
+    while(d.w > 1 || d.h > 1)
+    {
+        d = { (d.w + 1) / 2, (d.h + 1) / 2 };
+        mips.push_back({ d, std::vector<rgb_t>(d.w * d.h) });
+    }
+
+    update(level, to_rect(level.dimen()));
+}
+
+void level_pyramid_t::update(level_model_t const& level, rect_t rect)
+{
+    if(mips.empty() || !(rect = crop(rect, mips[0].dimen)))
+        return;
+
+    for(coord_t c : rect_range(rect))
+        mips[0].at(c) = level.tile_color(level.chr_layer.tiles.at(c));
+
+    for(unsigned i = 1; i < mips.size(); ++i)
+    {
+        coord_t const c0 = { rect.c.x / 2, rect.c.y / 2 };
+        coord_t const c1 = { (rect.e().x + 1) / 2, (rect.e().y + 1) / 2 };
+        rect = crop(rect_t{ c0, dimen_t{ c1.x - c0.x, c1.y - c0.y } }, mips[i].dimen);
+        downsample(i, rect);
+    }
+}
+
+void level_pyramid_t::downsample(unsigned i, rect_t rect)
+{
+    mip_t& src = mips[i - 1];
+    mip_t& dst = mips[i];
+
+    for(coord_t c : rect_range(rect))
+    {
+        unsigned r = 0, g = 0, b = 0, n = 0;
+        for(coord_t o : dimen_range({ 2, 2 }))
+        {
+            coord_t const s = { c.x * 2 + o.x, c.y * 2 + o.y };
+            if(!in_bounds(s, src.dimen))
+                continue;
+            rgb_t const color = src.at(s);
+            r += color.r;
+            g += color.g;
+            b += color.b;
+            n += 1;
+        }
+        assert(n > 0);
+        dst.at(c) = { std::uint8_t(r / n), std::uint8_t(g / n), std::uint8_t(b / n) };
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// minimap_t ///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+minimap_t::minimap_t(wxWindow* parent, std::shared_ptr<level_model_t> level, grid_box_t& canvas)
+: wxWindow(parent, wxID_ANY)
+, level(std::move(level))
+, canvas(canvas)
+{
+    SetMinSize(wxSize(256, 128));
+    SetBackgroundStyle(wxBG_STYLE_PAINT);
+
+    Bind(wxEVT_PAINT, &minimap_t::on_paint, this);
+    Bind(wxEVT_SIZE, &minimap_t::on_size, this);
+    Bind(wxEVT_LEFT_DOWN, &minimap_t::on_mouse, this);
+    Bind(wxEVT_MOTION, &minimap_t::on_mouse, this);
+}
+
+void minimap_t::on_update()
+{
+    bool changed = false;
+
+    if(level->chr_generation != chr_generation_seen || !(level->dimen() == dimen_seen))
+    {
+        pyramid.rebuild(*level);
+        chr_generation_seen = level->chr_generation;
+        dimen_seen = level->dimen();
+        changed = true;
+    }
+    else if(!level->chr_layer.for_each_touched(chr_seen, [&](rect_t r) { pyramid.update(*level, r); changed = true; }))
+    {
+        pyramid.rebuild(*level);
+        changed = true;
+    }
+    chr_seen = level->chr_layer.generation;
+
+    if(changed)
+        bitmap_dirty = true;
+
+    rect_t const view = canvas.view_rect();
+    if(changed || !(view.c == view_seen.c && view.d == view_seen.d))
+    {
+        view_seen = view;
+        Refresh();
+    }
+}
+
+void minimap_t::rebuild_bitmap()
+{
+    bitmap_dirty = false;
+    bitmap = wxBitmap();
+
+    wxSize const size = GetClientSize();
+    if(pyramid.depth() == 0 || size.x <= 0 || size.y <= 0)
+        return;
+
+    // Use the finest level that fits, scaled up by a whole number:
+    mip = pyramid.depth() - 1;
+    for(unsigned i = 0; i < pyramid.depth(); ++i)
+    {
+        if(pyramid.dimen(i).w <= size.x && pyramid.dimen(i).h <= size.y)
+        {
+            mip = i;
+            break;
+        }
+    }
+
+    dimen_t const d = pyramid.dimen(mip);
+    if(d.w <= 0 || d.h <= 0)
+        return;
+    zoom = std::max(1, std::min(size.x / d.w, size.y / d.h));
+
+    wxImage image(d.w, d.h, false);
+    std::memcpy(image.GetData(), pyramid.colors(mip), d.w * d.h * sizeof(rgb_t));
+    if(zoom > 1)
+        image.Rescale(d.w * zoom, d.h * zoom, wxIMAGE_QUALITY_NEAREST);
+    bitmap = wxBitmap(image);
+}
+
+void minimap_t::on_paint(wxPaintEvent& event)
+{
+    if(bitmap_dirty)
+        rebuild_bitmap();
+
+    wxPaintDC dc(this);
+    dc.SetBackground(*wxBLACK_BRUSH);
+    dc.Clear();
+
+    if(!bitmap.IsOk())
+        return;
+
+    dc.DrawBitmap(bitmap, 0, 0);
+
+    // Outline the part of the level the canvas shows:
+    double const texel = double(zoom) / double(8 << mip);
+    int const x = (view_seen.c.x - canvas.margin().w) * texel;
+    int const y = (view_seen.c.y - canvas.margin().h) * texel;
+    dc.SetPen(wxPen(*wxWHITE, 1));
+    dc.SetBrush(*wxTRANSPARENT_BRUSH);
+    dc.DrawRectangle(x, y, std::max(2, int(view_seen.d.w * texel)), std::max(2, int(view_seen.d.h * texel)));
+}
+
+void minimap_t::on_size(wxSizeEvent& event)
+{
+    bitmap_dirty = true;
+    Refresh();
+    event.Skip();
+}
+
+void minimap_t::on_mouse(wxMouseEvent& event)
+{
+    if(!event.LeftIsDown())
+    {
+        event.Skip();
+        return;
+    }
+
+    double const pixels = double(8 << mip) / double(zoom);
+    wxPoint const p = event.GetPosition();
+    canvas.center_on({ int(p.x * pixels) + canvas.margin().w, int(p.y * pixels) + canvas.margin().h });
+}
@@ -0,0 +1,73 @@
+#ifndef MINIMAP_HPP
+#define MINIMAP_HPP
+
+#include <memory>
+#include <vector>
+
+#include <wx/wx.h>
+
+#include "2d/geometry.hpp"
+
+#include "model.hpp"
+#include "grid_box.hpp"
+
+using namespace i2d;
+
+// One averaged color per level tile, plus successively halved copies of that.
+// Edits only recompute the touched tiles and their parents.
+class level_pyramid_t
+{
+public:
+    void rebuild(level_model_t const& level);
+    void update(level_model_t const& level, rect_t tiles);
+
+    unsigned depth() const { return mips.size(); }
+    dimen_t dimen(unsigned i) const { return mips[i].dimen; }
+    rgb_t const* colors(unsigned i) const { return mips[i].colors.data(); }
+
+private:
+    struct mip_t
+    {
+        dimen_t dimen;
+        std::vector<rgb_t> colors;
+
+        rgb_t& at(coord_t c) { return colors[c.x + c.y * dimen.w]; }
+    };
+
+    void downsample(unsigned i, rect_t rect);
+
+    std::vector<mip_t> mips;
+};
+
+// An overview of the whole level. Click to jump, drag to pan.
+class minimap_t : public wxWindow
+{
+public:
+    minimap_t(wxWindow* parent, std::shared_ptr<level_model_t> level, grid_box_t& canvas);
+
+    // Called on idle to pick up edits and scrolling.
+    void on_update();
+
+private:
+    std::shared_ptr<level_model_t> level;
+    grid_box_t& canvas;
+    level_pyramid_t pyramid;
+
+    std::uint64_t chr_seen = 0;
+    std::uint64_t chr_generation_seen = ~0ull;
+    dimen_t dimen_seen = {};
+    rect_t view_seen = {};
+
+    wxBitmap bitmap;
+    bool bitmap_dirty = true;
+    unsigned mip = 0;
+    int zoom = 1;
+
+    void on_paint(wxPaintEvent& event);
+    void on_size(wxSizeEvent& event);
+    void on_mouse(wxMouseEvent& event);
+
+    void rebuild_bitmap();
+};
+
+#endif
@@ -1,9 +1,12 @@
 #include "model.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <ranges>
 
 #include "json.hpp"
 #include "graphics.hpp"
+#include "perf.hpp"
 
 using json = nlohmann::json;
 
@@ -67,6 +70,7 @@ void object_t::from_vec(std::uint32_t const*& ptr, std::uint32_t const* end)
 void select_map_t::select_all(bool select)
 { 
     m_selection.fill(select); 
+    m_generation += 1;
     if(select)
         m_select_rect = to_rect(dimen());
     else
@@ -78,6 +82,7 @@ void select_map_t::select_invert()
     coord_t min = { INT_MAX, INT_MAX };
     coord_t max = { 0, 0 };
 
+    m_generation += 1;
     for(coord_t c : dimen_range(dimen()))
     {
         if((m_selection[c] = !m_selection[c]))
@@ -110,6 +115,7 @@ void select_map_t::select(coord_t c, bool select)
     if(!in_bounds(c, dimen()))
         return;
     m_selection.at(c) = select; 
+    m_generation += 1;
     if(select)
         m_select_rect = grow_rect_to_contain(m_select_rect, c);
     else
@@ -120,6 +126,7 @@ void select_map_t::select(rect_t r, bool select)
 { 
     if((r = crop(r, dimen())))
     {
+        m_generation += 1;
         for(coord_t c : rect_range(r))
         {
             assert(in_bounds(c, dimen()));
@@ -135,6 +142,7 @@ void select_map_t::select(rect_t r, bool select)
 void select_map_t::resize(dimen_t d) 
 { 
     m_selection.resize(d);
+    m_generation += 1;
     recalc_select_rect(to_rect(d));
 }
 
@@ -160,6 +168,16 @@ void select_map_t::recalc_select_rect(rect_t range)
         m_select_rect = {};
 }
 
+tile_shape_t const& select_map_t::shape() const
+{
+    if(m_shape_generation != m_generation)
+    {
+        m_shape = make_tile_shape(m_select_rect, [&](coord_t c) { return m_selection[c]; });
+        m_shape_generation = m_generation;
+    }
+    return m_shape;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // tile_layer_t ///////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -229,6 +247,79 @@ undo_t tile_layer_t::fill()
     return ret;
 }
 
+undo_t tile_layer_t::flood_fill(coord_t at, std::uint32_t value, std::uint32_t mask)
+{
+    dimen_t const dimen = canvas_dimen();
+    if(!in_bounds(at, dimen))
+        return {};
+
+    std::uint32_t const target = tiles.at(at) & mask;
+    if(target == (value & mask))
+        return {};
+
+    // Mark the region first, as the undo has to be saved before anything changes.
+    // Spans are filled a row at a time, with a seed pushed for each run above and below,
+    // so the stack stays small and there's no recursion.
+    std::vector<std::uint8_t> filled(dimen.w * dimen.h);
+    auto const matches = [&](int x, int y)
+    {
+        return !filled[x + y * dimen.w] && (tiles.at({ x, y }) & mask) == target;
+    };
+
+    coord_t c0 = at;
+    coord_t c1 = at;
+    std::vector<rect_t> spans;
+    std::vector<coord_t> stack = { at };
+    while(!stack.empty())
+    {
+        coord_t const seed = stack.back();
+        stack.pop_back();
+        if(!matches(seed.x, seed.y))
+            continue;
+
+        int x0 = seed.x;
+        int x1 = seed.x;
+        while(x0 > 0 && matches(x0 - 1, seed.y))
+            --x0;
+        while(x1 < dimen.w - 1 && matches(x1 + 1, seed.y))
+            ++x1;
+        std::fill_n(filled.begin() + x0 + seed.y * dimen.w, x1 - x0 + 1, 1);
+        spans.push_back({ coord_t{ x0, seed.y }, dimen_t{ x1 - x0 + 1, 1 } });
+
+        c0 = { std::min(c0.x, x0), std::min(c0.y, seed.y) };
+        c1 = { std::max(c1.x, x1), std::max(c1.y, seed.y) };
+
+        for(int y : { seed.y - 1, seed.y + 1 })
+        {
+            if(y < 0 || y >= dimen.h)
+                continue;
+            bool in_run = false;
+            for(int x = x0; x <= x1; ++x)
+            {
+                bool const m = matches(x, y);
+                if(m && !in_run)
+                    stack.push_back({ x, y });
+                in_run = m;
+            }
+        }
+    }
+
+    // The spans are disjoint, so the undo holds each filled tile once:
+    undo_tile_spans_t ret = { this, { c0, dimen_t{ c1.x - c0.x + 1, c1.y - c0.y + 1 } } };
+    for(rect_t const& span : spans)
+    {
+        for(coord_t c : rect_range(span))
+        {
+            ret.tiles.push_back(tiles.at(c));
+            tiles.at(c) = (tiles.at(c) & ~mask) | (value & mask);
+        }
+    }
+    ret.spans = std::move(spans);
+    touch(ret.bounds);
+
+    return ret;
+}
+
 undo_t tile_layer_t::fill_paste(tile_copy_t const& copy)
 {
     if(auto* grid = std::get_if<grid_t<std::uint32_t>>(&copy.data))
@@ -256,6 +347,36 @@ undo_t tile_layer_t::fill_paste(tile_copy_t const& copy)
     return {};
 }
 
+void tile_layer_t::touch(rect_t rect)
+{
+    static constexpr std::size_t TOUCH_LIMIT = 64;
+
+    if(!rect)
+        return;
+
+    generation += 1;
+
+    // Edits tend to come in runs of neighboring tiles, so grow the last rect when that's cheap:
+    auto const area = [](rect_t r) { return r.d.w * r.d.h; };
+    if(!touched.empty())
+    {
+        rect_t const last = touched.back().second;
+        rect_t const merged = grow_rect_to_contain(last, rect);
+        if(area(merged) <= 2 * (area(last) + area(rect)))
+        {
+            touched.back() = { generation, merged };
+            return;
+        }
+    }
+
+    touched.emplace_back(generation, rect);
+    if(touched.size() > TOUCH_LIMIT)
+    {
+        forgotten = touched.front().first;
+        touched.pop_front();
+    }
+}
+
 undo_t tile_layer_t::save(rect_t rect)
 {
     rect = crop(rect, canvas_dimen());
@@ -283,6 +404,7 @@ undo_t chr_layer_t::fill_attribute()
         tiles.at(c) &= 0xFFFF3FFF;
         tiles.at(c) |= (active & 0b11) << 14;
     });
+    touch(canvas_rect);
 
     return ret;
 }
@@ -298,33 +420,75 @@ dimen_t collision_layer_t::tile_size(model_t const& m) const
 
 void level_model_t::clear_chr()
 {
-    chr_bitmaps.clear();
+    chr_pending.reset();
+    chr_request += 1;
+    chr_colors.clear();
+    chr_planes.clear();
+    chr_generation += 1;
 }
 
 void level_model_t::refresh_chr(std::deque<chr_file_t> const& chr_deque, palette_array_t const& palette)
 {
-    chr_bitmaps.clear();
+    // The decoded planes are shared, so only the palette lookup happens per refresh.
+    std::vector<std::pair<unsigned, std::shared_ptr<chr_planes_t const>>> sources;
+    sources.reserve(chr_deque.size());
     for(chr_file_t const& chr : chr_deque)
+        sources.emplace_back(chr.id, chr.planes);
+
+    auto pending = chr_pending = std::make_shared<pending_t<chr_rgb_t>>();
+    std::uint64_t const request = ++chr_request;
+
+    workers().submit([pending, request, palette, sources = std::move(sources)]()
     {
-        auto bmp = chr_to_bitmaps(chr.chr.data(), chr.chr.size(), palette.data(), chr.indices);
-        std::vector<attr_gc_bitmaps_t> bitmaps;
-        bitmaps.reserve(bmp.size());
-        for(unsigned i = 0; i < bmp.size(); ++i)
-            bitmaps.push_back(convert_bitmap(bmp[i]));
-        chr_bitmaps.emplace(chr.id, std::move(bitmaps));
-    }
+        auto const start = perf_clock_t::now();
+        chr_rgb_t result = { request };
+        for(auto const& source : sources)
+            result.colors.emplace_back(source.first, average_rgb(planes_to_rgb(*source.second, palette.data())));
+        result.planes = std::move(sources);
+        result.lut = make_attr_lut(palette.data());
+        result.ms = ms_since(start);
+        pending->post(std::move(result));
+    });
 }
 
-unsigned level_model_t::count_mt(unsigned metatile_size, unsigned select) 
+bool level_model_t::poll_chr()
 {
-    struct mt_t
-    {
-        std::vector<std::uint32_t> tiles;
-        std::uint8_t collision;
+    if(!chr_pending)
+        return false;
+
+    std::optional<chr_rgb_t> result = chr_pending->take();
+    if(!result)
+        return false;
+    chr_pending.reset();
+    if(result->request != chr_request)
+        return false;
+
+    auto const start = perf_clock_t::now();
+
+    // No bitmaps are built here. Views rebuild the tiles they draw once 'chr_generation' changes.
+    chr_colors.clear();
+    for(auto& pair : result->colors)
+        chr_colors.emplace(pair.first, std::move(pair.second));
+    chr_planes.clear();
+    for(auto& pair : result->planes)
+        chr_planes.emplace(pair.first, std::move(pair.second));
+    chr_lut = result->lut;
+    chr_refresh_ms = result->ms + ms_since(start);
+    chr_generation += 1;
+
+    return true;
+}
 
-        auto operator<=>(mt_t const&) const = default;
-    };
+rgb_t level_model_t::tile_color(std::uint32_t tile) const
+{
+    auto const it = chr_colors.find(chr_id(tile));
+    if(it == chr_colors.end() || tile_tile(tile) >= it->second.size())
+        return BAD_TILE_RGB;
+    return it->second[tile_tile(tile)][tile_attr(tile)];
+}
 
+unsigned level_model_t::count_mt(unsigned metatile_size, unsigned select) 
+{
     unsigned const s = metatile_size;
 
     if(s == 0)
@@ -333,59 +497,220 @@ unsigned level_model_t::count_mt(unsigned metatile_size, unsigned select)
     if(select)
         chr_layer.canvas_selector.select_all(false);
 
-    std::map<mt_t, unsigned> mt_map;
-
     dimen_t const d = chr_layer.canvas_dimen();
+    unsigned const bw = (d.w + s - 1) / s;
+    unsigned const bh = (d.h + s - 1) / s;
+    std::size_t const n = bw * bh;
 
-    for(unsigned y = 0; y < d.h; y += s)
-    for(unsigned x = 0; x < d.w; x += s)
+    if(n == 0)
+        return 0;
+
+    // Blocks past the edge are padded with tile 0:
+    auto const tile_at = [&](unsigned x, unsigned y) -> std::uint32_t
     {
-        mt_t mt = {};
+        return (x < unsigned(d.w) && y < unsigned(d.h)) ? chr_layer.tiles[x + y*d.w] : 0;
+    };
+    auto const collision_at = [&](std::size_t b) { return std::uint8_t(collision_layer.tiles[b]); };
 
+    auto const same_block = [&](std::size_t a, std::size_t b)
+    {
+        if(collision_at(a) != collision_at(b))
+            return false;
+        unsigned const ax = (a % bw) * s, ay = (a / bw) * s;
+        unsigned const bx = (b % bw) * s, by = (b / bw) * s;
         for(unsigned yy = 0; yy < s; yy += 1)
         for(unsigned xx = 0; xx < s; xx += 1)
-        {
-            if(x+xx < d.w && y+yy < d.h)
-                mt.tiles.push_back(chr_layer.tiles[x+xx + (y+yy)*d.w]);
-            else
-                mt.tiles.push_back(0);
-        }
-
-        mt.collision = collision_layer.tiles[(x / s) + (y / s) * ((d.w + s - 1) / s)];
-        mt_map[mt] += 1;
-    }
+            if(tile_at(ax+xx, ay+yy) != tile_at(bx+xx, by+yy))
+                return false;
+        return true;
+    };
 
-    if(select)
+    // Hash every block, a row of blocks per job:
+    std::vector<std::uint64_t> hashes(n);
+    parallel_for(0, bh, [&](unsigned by)
     {
-        for(unsigned y = 0; y < d.h; y += s)
-        for(unsigned x = 0; x < d.w; x += s)
+        for(unsigned bx = 0; bx < bw; bx += 1)
         {
-            mt_t mt = {};
-
+            std::uint64_t h = collision_at(bx + by * bw);
             for(unsigned yy = 0; yy < s; yy += 1)
             for(unsigned xx = 0; xx < s; xx += 1)
             {
-                if(x+xx < d.w && y+yy < d.h)
-                    mt.tiles.push_back(chr_layer.tiles[x+xx + (y+yy)*d.w]);
-                else
-                    mt.tiles.push_back(0);
+                h = (h + tile_at(bx*s + xx, by*s + yy)) * 0x9E3779B97F4A7C15ull;
+                h ^= h >> 29;
             }
+            hashes[bx + by * bw] = h;
+        }
+    });
 
-            mt.collision = collision_layer.tiles[(x / s) + (y / s) * ((d.w + s - 1) / s)];
+    // Then count them in an open-addressing table, comparing fully on equal hashes.
+    // Each block keeps its slot, so selecting doesn't rebuild anything.
+    struct slot_t
+    {
+        std::uint64_t hash;
+        std::size_t block;
+        unsigned count; // 0 when empty.
+    };
+
+    std::size_t const mask = std::bit_ceil(n * 2) - 1;
+    std::vector<slot_t> table(mask + 1);
+    std::vector<std::size_t> slots(n);
+    unsigned unique = 0;
+
+    for(std::size_t b = 0; b < n; b += 1)
+    {
+        std::size_t i = hashes[b] & mask;
+        while(table[i].count && !(table[i].hash == hashes[b] && same_block(table[i].block, b)))
+            i = (i + 1) & mask;
+
+        if(!table[i].count)
+        {
+            table[i] = { hashes[b], b, 0 };
+            unique += 1;
+        }
+        table[i].count += 1;
+        slots[b] = i;
+    }
 
-            if(mt_map[mt] <= select)
+    if(select)
+    {
+        for(std::size_t b = 0; b < n; b += 1)
+        {
+            if(table[slots[b]].count <= select)
             {
-                for(unsigned yy = 0; yy < s; yy += 1)
-                for(unsigned xx = 0; xx < s; xx += 1)
-                    chr_layer.canvas_selector.select(coord_t{ x+xx, y+yy });
+                coord_t const c = { int((b % bw) * s), int((b / bw) * s) };
+                chr_layer.canvas_selector.select(rect_t{ c, dimen_t{ int(s), int(s) } });
             }
         }
     }
 
-    return mt_map.size();
+    return unique;
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// mt_census_t /////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+std::size_t mt_census_t::key_hash_t::operator()(key_t const& key) const
+{
+    std::uint64_t h = key.size();
+    for(std::uint32_t value : key)
+    {
+        h = (h + value) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+mt_census_t::key_t mt_census_t::make_key(chr_layer_t const& chr, collision_layer_t const& collision, std::size_t block) const
+{
+    // Like 'count_mt', blocks past the edge are padded with tile 0:
+    unsigned const s = metatile_size;
+    coord_t const b = { int(block % blocks_w), int(block / blocks_w) };
+    key_t key;
+    key.reserve(s * s + 1);
+    for(unsigned yy = 0; yy < s; yy += 1)
+    for(unsigned xx = 0; xx < s; xx += 1)
+    {
+        coord_t const c = { int(b.x * s + xx), int(b.y * s + yy) };
+        key.push_back(in_bounds(c, dimen) ? chr.tiles.at(c) : 0);
+    }
+    key.push_back(in_bounds(b, collision.tiles.dimen()) ? std::uint8_t(collision.tiles.at(b)) : 0);
+    return key;
+}
+
+void mt_census_t::reset()
+{
+    dictionary.clear();
+    blocks.clear();
+    built = false;
+    m_delta = 0;
+}
+
+void mt_census_t::rebuild(chr_layer_t const& chr, collision_layer_t const& collision)
+{
+    dictionary.clear();
+    blocks.clear();
+    if(metatile_size == 0)
+        return;
+
+    blocks_w = (dimen.w + metatile_size - 1) / metatile_size;
+    unsigned const blocks_h = (dimen.h + metatile_size - 1) / metatile_size;
+    blocks.resize(blocks_w * blocks_h);
+    for(std::size_t b = 0; b < blocks.size(); b += 1)
+    {
+        auto& entry = *dictionary.try_emplace(make_key(chr, collision, b), 0).first;
+        entry.second += 1;
+        blocks[b] = &entry;
+    }
+}
+
+void mt_census_t::rekey(chr_layer_t const& chr, collision_layer_t const& collision, std::size_t block)
+{
+    key_t key = make_key(chr, collision, block);
+    if(key == blocks[block]->first)
+        return;
+
+    if(--blocks[block]->second == 0)
+        dictionary.erase(blocks[block]->first);
+
+    auto& entry = *dictionary.try_emplace(std::move(key), 0).first;
+    entry.second += 1;
+    blocks[block] = &entry;
+}
+
+bool mt_census_t::update(chr_layer_t const& chr, collision_layer_t const& collision, unsigned metatile_size)
+{
+    unsigned const before = count();
+    int const before_delta = m_delta;
+    unsigned const s = metatile_size;
+    dimen_t const d = chr.tiles.dimen();
+    bool full = !built || s != this->metatile_size || !(d == dimen);
+
+    // The touched blocks, which may repeat:
+    std::vector<std::size_t> dirty;
+    unsigned const blocks_h = s ? (d.h + s - 1) / s : 0;
+    auto const add_blocks = [&](rect_t r)
+    {
+        if(!(r = crop(r, dimen_t{ int(blocks_w), int(blocks_h) })))
+            return;
+        for(coord_t c : rect_range(r))
+            dirty.push_back(c.x + c.y * blocks_w);
+    };
+
+    if(!full && s)
+    {
+        full = !chr.for_each_touched(chr_seen, [&](rect_t r)
+        {
+            coord_t const c0 = { r.c.x / int(s), r.c.y / int(s) };
+            coord_t const c1 = { (r.e().x - 1) / int(s) + 1, (r.e().y - 1) / int(s) + 1 };
+            add_blocks({ c0, dimen_t{ c1.x - c0.x, c1.y - c0.y } });
+        });
+        full = full || !collision.for_each_touched(collision_seen, add_blocks);
+    }
+    chr_seen = chr.generation;
+    collision_seen = collision.generation;
+
+    if(full)
+    {
+        built = true;
+        this->metatile_size = s;
+        dimen = d;
+        rebuild(chr, collision);
+        m_delta = 0;
+    }
+    else if(!dirty.empty())
+    {
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        for(std::size_t b : dirty)
+            rekey(chr, collision, b);
+        m_delta = int(count()) - int(before);
+    }
+
+    return count() != before || m_delta != before_delta;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // model_t /////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -399,6 +724,24 @@ undo_t model_t::operator()(undo_tiles_t const& undo)
     return ret;
 }
 
+undo_t model_t::operator()(undo_tile_spans_t const& undo)
+{
+    // Written directly and touched once, as fills can be big:
+    undo_tile_spans_t ret = { undo.layer, undo.bounds, undo.spans };
+    ret.tiles.reserve(undo.tiles.size());
+    unsigned i = 0;
+    for(rect_t const& span : undo.spans)
+    {
+        for(coord_t c : rect_range(span))
+        {
+            ret.tiles.push_back(undo.layer->tiles.at(c));
+            undo.layer->tiles.at(c) = undo.tiles[i++];
+        }
+    }
+    undo.layer->touch(undo.bounds);
+    return ret;
+}
+
 undo_t model_t::operator()(undo_palette_num_t const& undo)
 {
     auto ret = undo_palette_num_t{ palette.num };
@@ -410,6 +753,7 @@ undo_t model_t::operator()(undo_level_dimen_t const& undo)
 {
     auto ret = undo_level_dimen_t{ undo.layer, undo.layer->tiles };
     undo.layer->tiles = undo.tiles;
+    undo.layer->touch_all();
     return ret;
 }
 
@@ -450,6 +794,28 @@ undo_t model_t::operator()(undo_move_objects_t const& undo)
     return ret;
 }
 
+bool model_t::poll_chr()
+{
+    bool changed = false;
+    for(chr_file_t& chr : chr_files)
+        changed |= chr.poll();
+    return changed;
+}
+
+void model_t::load_collisions()
+{
+    collision_image = load_collision_image(collision_path.string());
+    rescale_collisions();
+}
+
+void model_t::rescale_collisions()
+{
+    auto collisions = slice_collision_image(collision_image, collision_scale());
+    collision_bitmaps = std::move(collisions.first);
+    collision_wx_bitmaps = std::move(collisions.second);
+    collision_generation += 1;
+}
+
 palette_array_t model_t::palette_array(unsigned palette_index)
 {
     std::array<std::uint8_t, 16> ret;
@@ -462,6 +828,112 @@ palette_array_t model_t::palette_array(unsigned palette_index)
     return ret;
 }
 
+tile_replace_result_t model_t::replace_tiles(tile_replace_t const& replace)
+{
+    struct level_result_t
+    {
+        std::size_t matches = 0;
+        std::optional<undo_tiles_t> undo;
+    };
+
+    std::uint32_t const find = replace.find & replace.find_mask;
+    std::uint32_t const find_mask = replace.find_mask;
+    std::uint32_t const keep_mask = ~replace.replace_mask;
+    std::uint32_t const value = replace.replace & replace.replace_mask;
+
+    // Levels are independent, so each is one job.
+    // The inner loops are branch-free over raw rows, for the compiler to vectorize.
+    std::vector<level_result_t> results(levels.size());
+    parallel_for(0, levels.size(), [&](unsigned i)
+    {
+        chr_layer_t& layer = levels[i]->chr_layer;
+        dimen_t const d = layer.tiles.dimen();
+        bool const selected_only = replace.scope == tile_replace_t::SCOPE_SELECTION;
+
+        rect_t area = to_rect(d);
+        if(replace.scope == tile_replace_t::SCOPE_REGION)
+            area = crop(replace.region, d);
+        else if(selected_only)
+            area = crop(layer.canvas_selector.select_rect(), d);
+        if(!area)
+            return;
+
+        auto const row = [&](int y) { return &layer.tiles[y * d.w]; };
+        auto const selected = [&](int y) { return &layer.canvas_selector.selection()[y * d.w]; };
+        auto const count_row = [&](int y, int x0, int x1)
+        {
+            std::uint32_t const* const tiles = row(y);
+            std::size_t n = 0;
+            if(selected_only)
+            {
+                std::uint8_t const* const sel = selected(y);
+                for(int x = x0; x < x1; ++x)
+                    n += ((tiles[x] & find_mask) == find) & (sel[x] != 0);
+            }
+            else
+            {
+                for(int x = x0; x < x1; ++x)
+                    n += (tiles[x] & find_mask) == find;
+            }
+            return n;
+        };
+
+        // Count, and find the bounds of the matches for the undo:
+        level_result_t& result = results[i];
+        coord_t c0 = area.e();
+        coord_t c1 = area.c;
+        for(int y = area.c.y; y < area.e().y; ++y)
+        {
+            std::size_t const n = count_row(y, area.c.x, area.e().x);
+            if(!n)
+                continue;
+            result.matches += n;
+
+            int x0 = area.c.x;
+            while(!count_row(y, x0, x0 + 1))
+                ++x0;
+            int x1 = area.e().x;
+            while(!count_row(y, x1 - 1, x1))
+                --x1;
+            c0 = { std::min(c0.x, x0), std::min(c0.y, y) };
+            c1 = { std::max(c1.x, x1), y + 1 };
+        }
+
+        if(!result.matches || !replace.replace_mask)
+            return;
+
+        rect_t const bounds = { c0, dimen_t{ c1.x - c0.x, c1.y - c0.y } };
+        result.undo = std::get<undo_tiles_t>(layer.save(bounds));
+
+        for(int y = bounds.c.y; y < bounds.e().y; ++y)
+        {
+            std::uint32_t* const tiles = row(y);
+            std::uint8_t const* const sel = selected_only ? selected(y) : nullptr;
+            for(int x = bounds.c.x; x < bounds.e().x; ++x)
+            {
+                bool const match = (tiles[x] & find_mask) == find && (!sel || sel[x]);
+                tiles[x] = match ? (tiles[x] & keep_mask) | value : tiles[x];
+            }
+        }
+    });
+
+    tile_replace_result_t ret;
+    for(unsigned i = 0; i < results.size(); ++i)
+    {
+        level_result_t& result = results[i];
+        ret.matches += result.matches;
+        ret.levels += result.matches > 0;
+        if(result.matches)
+            ret.matched.push_back(levels[i].get());
+        if(result.undo)
+        {
+            result.undo->layer->touch(result.undo->rect);
+            ret.undos.push_back(std::move(*result.undo));
+        }
+    }
+    return ret;
+}
+
 constexpr std::uint8_t SAVE_VERSION = 1;
 
 void model_t::write_file(FILE* fp, std::filesystem::path base_path) const
@@ -645,9 +1117,7 @@ void model_t::read_file(FILE* fp, std::filesystem::path base_path)
     // Collision file:
     metatile_size = get8(false);
     collision_path = get_path();
-    auto collisions = load_collision_file(collision_path.string(), collision_scale());
-    collision_bitmaps = std::move(collisions.first);
-    collision_wx_bitmaps = std::move(collisions.second);
+    load_collisions();
 
     // CHR:
     unsigned const num_chr = get8(true);
@@ -907,9 +1377,7 @@ void model_t::read_json(FILE* fp, std::filesystem::path base_path)
 
     // Collision file:
     collision_path = convert_path(data.at("collision_path").get<std::string>());
-    auto collisions = load_collision_file(collision_path.string());
-    collision_bitmaps = std::move(collisions.first);
-    collision_wx_bitmaps = std::move(collisions.second);
+    load_collisions();
 
     // CHR:
     chr_files.clear();
@@ -1059,32 +1527,93 @@ void undo_history_t::push(undo_t const& undo)
 // chr_file_t //////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-void chr_file_t::load()
+// Reads and converts the file at 'path'. Safe to call from any thread.
+static chr_patterns_t read_chr_file(std::filesystem::path const& path)
 {
-    chr = {};
+    chr_patterns_t ret;
+
     if(path.empty())
-        return;
+        return ret;
     std::vector<std::uint8_t> data = read_binary_file(path.string().c_str());
-    indices.clear();
 
     if(data.empty())
-        return;
+        return ret;
 
     std::string ext = path.extension().string();
     for(char& c : ext)
         c = std::tolower(c);
 
     if(ext == ".png")
-    {
-        auto result = png_to_chr(data.data(), data.size());
-        data = std::move(result.chr);
-        indices = std::move(result.indices);
-    }
+        ret = png_to_chr(data.data(), data.size());
     else
     {
         for(unsigned i = 0; i < data.size() / 16; i += 1)
-            indices.push_back(i);
+            ret.indices.push_back(i);
+        ret.chr = std::move(data);
     }
 
-    std::copy_n(data.begin(), std::min(data.size(), chr.size()), chr.begin());
+    return ret;
+}
+
+static std::shared_ptr<chr_planes_t const> decode_chr(chr_patterns_t const& patterns)
+{
+    chr_array_t chr = {};
+    std::copy_n(patterns.chr.begin(), std::min(patterns.chr.size(), chr.size()), chr.begin());
+    return std::make_shared<chr_planes_t const>(chr_to_planes(chr.data(), chr.size(), patterns.indices));
+}
+
+void chr_file_t::set_patterns(chr_patterns_t const& patterns, std::shared_ptr<chr_planes_t const> planes)
+{
+    chr = {};
+    indices = patterns.indices;
+    std::copy_n(patterns.chr.begin(), std::min(patterns.chr.size(), chr.size()), chr.begin());
+    this->planes = std::move(planes);
+}
+
+void chr_file_t::load()
+{
+    // Supersede any load still in flight:
+    load_generation += 1;
+    pending.reset();
+
+    set_patterns({}, std::make_shared<chr_planes_t const>());
+    chr_patterns_t const patterns = read_chr_file(path);
+    set_patterns(patterns, decode_chr(patterns));
+}
+
+void chr_file_t::load_async()
+{
+    auto pending = this->pending = std::make_shared<pending_t<loaded_t>>();
+    std::uint64_t const generation = ++load_generation;
+
+    workers().submit([pending, generation, path = path]()
+    {
+        loaded_t loaded = { generation };
+        try
+        {
+            loaded.patterns = read_chr_file(path);
+        }
+        catch(...)
+        {
+            loaded.patterns = {};
+        }
+        loaded.planes = decode_chr(loaded.patterns);
+        pending->post(std::move(loaded));
+    });
+}
+
+bool chr_file_t::poll()
+{
+    if(!pending)
+        return false;
+
+    std::optional<loaded_t> loaded = pending->take();
+    if(!loaded)
+        return false;
+    pending.reset();
+    if(loaded->generation != load_generation)
+        return false;
+
+    set_patterns(loaded->patterns, std::move(loaded->planes));
+    return true;
 }
@@ -4,7 +4,9 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
+#include <deque>
 #include <memory>
+#include <optional>
 #include <variant>
 #include <set>
 #include <filesystem>
@@ -16,6 +18,7 @@
 
 #include "convert.hpp"
 #include "tool.hpp"
+#include "worker.hpp"
 
 using namespace i2d;
 
@@ -73,6 +76,15 @@ struct undo_tiles_t
     std::vector<std::uint32_t> tiles;
 };
 
+// Only the tiles of some row spans, for edits that are sparse in their bounds, like flood fills.
+struct undo_tile_spans_t
+{
+    tile_layer_t* layer;
+    rect_t bounds;
+    std::vector<rect_t> spans; // One row each.
+    std::vector<std::uint32_t> tiles; // In span order.
+};
+
 struct undo_palette_num_t
 {
     int num;
@@ -113,6 +125,7 @@ struct undo_move_objects_t
 using undo_t = std::variant
     < std::monostate
     , undo_tiles_t
+    , undo_tile_spans_t
     , undo_palette_num_t
     , undo_level_dimen_t
     , undo_new_object_t
@@ -121,6 +134,90 @@ using undo_t = std::variant
     , undo_move_objects_t
     >;
 
+// A set of tiles as a few merged rects, plus the segments outlining them.
+// Drawing these is much cheaper than drawing every tile.
+struct tile_shape_t
+{
+    std::vector<rect_t> rects;
+    std::vector<std::pair<coord_t, coord_t>> outline; // In tile corners.
+};
+
+// Builds the shape of the tiles in 'bounds' where 'pred(c)' is true.
+template<typename Pred>
+tile_shape_t make_tile_shape(rect_t bounds, Pred const& pred)
+{
+    tile_shape_t ret;
+    auto const at = [&](int x, int y) { return in_bounds(coord_t{ x, y } - bounds.c, bounds.d) && pred(coord_t{ x, y }); };
+
+    // Horizontal runs, merged downwards while the row below has the exact same run:
+    std::vector<std::size_t> open, next;
+    for(int y = bounds.c.y; y < bounds.e().y; ++y)
+    {
+        next.clear();
+        std::size_t o = 0;
+        for(int x = bounds.c.x; x < bounds.e().x;)
+        {
+            if(!pred(coord_t{ x, y }))
+            {
+                ++x;
+                continue;
+            }
+            int const x0 = x;
+            while(x < bounds.e().x && pred(coord_t{ x, y }))
+                ++x;
+
+            while(o < open.size() && ret.rects[open[o]].c.x < x0)
+                ++o;
+            if(o < open.size() && ret.rects[open[o]].c.x == x0 && ret.rects[open[o]].e().x == x)
+            {
+                ret.rects[open[o]].d.h += 1;
+                next.push_back(open[o++]);
+            }
+            else
+            {
+                next.push_back(ret.rects.size());
+                ret.rects.push_back({ coord_t{ x0, y }, dimen_t{ x - x0, 1 } });
+            }
+        }
+        open.swap(next);
+    }
+
+    // Edges between tiles that differ, joined into segments:
+    for(int y = bounds.c.y; y <= bounds.e().y; ++y)
+    {
+        for(int x = bounds.c.x; x < bounds.e().x;)
+        {
+            if(at(x, y - 1) == at(x, y))
+            {
+                ++x;
+                continue;
+            }
+            int const x0 = x;
+            while(x < bounds.e().x && at(x, y - 1) != at(x, y))
+                ++x;
+            ret.outline.push_back({ coord_t{ x0, y }, coord_t{ x, y } });
+        }
+    }
+
+    for(int x = bounds.c.x; x <= bounds.e().x; ++x)
+    {
+        for(int y = bounds.c.y; y < bounds.e().y;)
+        {
+            if(at(x - 1, y) == at(x, y))
+            {
+                ++y;
+                continue;
+            }
+            int const y0 = y;
+            while(y < bounds.e().y && at(x - 1, y) != at(x, y))
+                ++y;
+            ret.outline.push_back({ coord_t{ x, y0 }, coord_t{ x, y } });
+        }
+    }
+
+    return ret;
+}
+
 // Used to select and deselect specific tiles:
 class select_map_t
 {
@@ -143,6 +240,9 @@ public:
 
     virtual void resize(dimen_t d) ;
 
+    // Cached until the selection changes.
+    tile_shape_t const& shape() const;
+
     template<typename Fn>
     void for_each_selected(Fn const& fn)
     {
@@ -156,6 +256,10 @@ private:
 
     rect_t m_select_rect = {};
     grid_t<std::uint8_t> m_selection;
+
+    std::uint64_t m_generation = 0;
+    mutable std::uint64_t m_shape_generation = ~0ull;
+    mutable tile_shape_t m_shape;
 };
 
 enum
@@ -172,6 +276,18 @@ struct tile_copy_t
     unsigned format;
     std::variant<grid_t<std::uint32_t>, std::vector<object_t>> data;
 
+    // The non-empty tiles of a grid, built on first use.
+    tile_shape_t const& shape() const
+    {
+        if(!m_shape)
+        {
+            m_shape.emplace();
+            if(auto const* grid = std::get_if<grid_t<std::uint32_t>>(&data))
+                *m_shape = make_tile_shape(to_rect(grid->dimen()), [&](coord_t c) { return (*grid)[c] != std::uint32_t(~0u); });
+        }
+        return *m_shape;
+    }
+
     std::vector<std::uint32_t> to_vec() const
     {
         if(auto* grid = std::get_if<grid_t<std::uint32_t>>(&data))
@@ -216,6 +332,8 @@ struct tile_copy_t
         }
         return ret;
     }
+
+    mutable std::optional<tile_shape_t> m_shape; // Cache for 'shape'.
 };
 
 struct object_copy_t
@@ -235,9 +353,9 @@ public:
     virtual unsigned format() const = 0;
     virtual dimen_t tile_size(model_t const& m) const { return { 8, 8 }; }
     virtual dimen_t canvas_dimen() const { return tiles.dimen(); }
-    virtual void canvas_resize(dimen_t d) { canvas_selector.resize(d); tiles.resize(d); }
+    virtual void canvas_resize(dimen_t d) { canvas_selector.resize(d); tiles.resize(d); touch_all(); }
     virtual std::uint32_t get(coord_t c) const { return tiles.at(c); }
-    virtual void set(coord_t c, std::uint32_t value) { tiles.at(c) = value; }
+    virtual void set(coord_t c, std::uint32_t value) { tiles.at(c) = value; touch({ c, { 1, 1 } }); }
     virtual void reset(coord_t c) { set(c, 0); }
     virtual std::uint32_t to_tile(coord_t pick) const { return pick.x + pick.y * picker_selector.dimen().w; }
     virtual coord_t to_pick(std::uint32_t tile) const { return { tile % picker_selector.dimen().w, tile / picker_selector.dimen().w }; }
@@ -248,6 +366,13 @@ public:
     virtual undo_t fill();
     virtual undo_t fill_paste(tile_copy_t const& copy);
 
+    // Sets the 'mask' bits of the 4-connected region around 'at' whose 'mask' bits match,
+    // returning a single undo that holds just the filled spans.
+    undo_t flood_fill(coord_t at, std::uint32_t value, std::uint32_t mask = ~0u);
+
+    // The bits that hold an attribute, for fills that change just that.
+    virtual std::uint32_t attribute_mask() const { return 0; }
+
     virtual void dropper(coord_t at);
 
     virtual undo_t save(coord_t at) { return save({ at, picker_selector.dimen() }); }
@@ -266,9 +391,31 @@ public:
         });
     }
 
+    // Every edit bumps 'generation' and logs the tiles it touched, so that views can redraw just those.
+    // Code that writes 'tiles' directly has to call 'touch' itself.
+    void touch(rect_t rect);
+    void touch_all() { touch(to_rect(tiles.dimen())); }
+
+    // Calls 'fn(rect)' for the tiles touched after generation 'since'.
+    // Returns false when the log doesn't reach back that far, meaning anything may have changed.
+    template<typename Fn>
+    bool for_each_touched(std::uint64_t since, Fn const& fn) const
+    {
+        if(since < forgotten)
+            return false;
+        for(auto it = touched.rbegin(); it != touched.rend() && it->first > since; ++it)
+            fn(it->second);
+        return true;
+    }
+
     select_map_t picker_selector;
     select_map_t canvas_selector;
     grid_t<std::uint32_t> tiles;
+    std::uint64_t generation = 0;
+
+private:
+    std::deque<std::pair<std::uint64_t, rect_t>> touched;
+    std::uint64_t forgotten = 0;
 };
 
 class tile_model_t
@@ -289,8 +436,26 @@ struct chr_file_t
     std::filesystem::path path;
     chr_array_t chr = {};
     std::vector<std::uint16_t> indices;
+    std::shared_ptr<chr_planes_t const> planes = std::make_shared<chr_planes_t>(); // Decoded 'chr'.
 
     void load();
+
+    // Decodes on a worker thread. The old data stays in use until 'poll' swaps the new data in.
+    void load_async();
+    bool poll();
+
+    struct loaded_t
+    {
+        std::uint64_t generation;
+        chr_patterns_t patterns;
+        std::shared_ptr<chr_planes_t const> planes;
+    };
+
+    std::uint64_t load_generation = 0;
+    std::shared_ptr<pending_t<loaded_t>> pending;
+
+private:
+    void set_patterns(chr_patterns_t const& patterns, std::shared_ptr<chr_planes_t const> planes);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -367,10 +532,11 @@ public:
     {}
 
     virtual unsigned format() const override { return LAYER_CHR; }
-    virtual void reset(coord_t c) { tiles.at(c) = 0; }
+    virtual void reset(coord_t c) { tiles.at(c) = 0; touch({ c, { 1, 1 } }); }
     virtual std::uint32_t to_tile(coord_t pick) const { return tile_layer_t::to_tile(pick) | ((active & 0b11) << 14) | (chr_id << 16); }
     virtual coord_t to_pick(std::uint32_t tile) const override { tile &= 0x3FFF; return { tile % picker_selector.dimen().w, tile / picker_selector.dimen().w }; }
     virtual void dropper(coord_t at) override;
+    virtual std::uint32_t attribute_mask() const override { return 0b11 << 14; }
     undo_t fill_attribute();
 
     unsigned& chr_id;
@@ -403,6 +569,50 @@ enum level_layer_t
     OBJECT_LAYER,
 };
 
+// Keeps the unique metatile count of a level current as it's edited.
+// Every block refers to its entry in a refcounted dictionary, so an edit only re-keys the blocks it touched.
+class mt_census_t
+{
+public:
+    mt_census_t() = default;
+
+    // 'blocks' points into the dictionary, so copies start over and rebuild from their own level.
+    mt_census_t(mt_census_t const&) {}
+    mt_census_t& operator=(mt_census_t const&) { reset(); return *this; }
+
+    // Picks up edits from the layers' touch logs. Returns true when the count or delta changed.
+    bool update(chr_layer_t const& chr, collision_layer_t const& collision, unsigned metatile_size);
+
+    unsigned count() const { return dictionary.size(); }
+    int delta() const { return m_delta; } // What the last edit did to the count. Rebuilds don't count as edits.
+
+private:
+    using key_t = std::vector<std::uint32_t>; // A block's tiles, then its collision.
+
+    struct key_hash_t
+    {
+        std::size_t operator()(key_t const& key) const;
+    };
+
+    using dictionary_t = std::unordered_map<key_t, unsigned, key_hash_t>;
+
+    void reset();
+    void rebuild(chr_layer_t const& chr, collision_layer_t const& collision);
+    void rekey(chr_layer_t const& chr, collision_layer_t const& collision, std::size_t block);
+    key_t make_key(chr_layer_t const& chr, collision_layer_t const& collision, std::size_t block) const;
+
+    dictionary_t dictionary;
+    std::vector<dictionary_t::value_type*> blocks; // Element pointers survive rehashing.
+    unsigned blocks_w = 0;
+
+    bool built = false;
+    unsigned metatile_size = 0;
+    dimen_t dimen = {};
+    std::uint64_t chr_seen = 0;
+    std::uint64_t collision_seen = 0;
+    int m_delta = 0;
+};
+
 class level_model_t : public tile_model_t
 {
 public:
@@ -425,8 +635,12 @@ public:
 
     void clear_chr();
     void refresh_chr(std::deque<chr_file_t> const& chr_deque, palette_array_t const& palette);
+    bool poll_chr();
 
     unsigned count_mt(unsigned metatile_size, unsigned select = 0);
+    mt_census_t mt_census;
+
+    rgb_t tile_color(std::uint32_t tile) const;
 
     void reindex_objects();
 
@@ -438,7 +652,26 @@ public:
     chr_layer_t chr_layer = chr_layer_t(this->chr_id, this->active);
     collision_layer_t collision_layer;
     std::vector<unsigned> chr_ids;
-    std::unordered_map<unsigned, std::vector<attr_gc_bitmaps_t>> chr_bitmaps;
+    std::unordered_map<unsigned, std::vector<std::array<rgb_t, 4>>> chr_colors; // Average of each tile, per attribute.
+    std::unordered_map<unsigned, std::shared_ptr<chr_planes_t const>> chr_planes; // For the software compositor.
+    attr_lut_t chr_lut = {};
+
+    // 'refresh_chr' builds the colors on a worker thread, and 'poll_chr' swaps them in.
+    // Views build their tile bitmaps from 'chr_planes' and 'chr_lut' as they draw them.
+    // Results from requests older than 'chr_request' are dropped.
+    struct chr_rgb_t
+    {
+        std::uint64_t request;
+        std::vector<std::pair<unsigned, std::vector<std::array<rgb_t, 4>>>> colors;
+        std::vector<std::pair<unsigned, std::shared_ptr<chr_planes_t const>>> planes;
+        attr_lut_t lut;
+        double ms; // Time spent on the worker.
+    };
+
+    std::uint64_t chr_request = 0;
+    std::uint64_t chr_generation = 0; // Bumped whenever 'chr_planes' or 'chr_lut' changes.
+    std::shared_ptr<pending_t<chr_rgb_t>> chr_pending;
+    double chr_refresh_ms = 0; // How long the last refresh took, on the worker and in 'poll_chr'.
     level_layer_t current_layer = ATTR0_LAYER;
     std::uint8_t active = 0;
 
@@ -448,6 +681,29 @@ public:
     wxImage bad_chr;
 };
 
+// A find and replace over the CHR tiles of every level.
+// Tiles match when their 'find_mask' bits equal those of 'find', so clear bits are wildcards.
+// Matches then get their 'replace_mask' bits from 'replace'. With no 'replace_mask' bits, tiles are only counted.
+struct tile_replace_t
+{
+    enum scope_t { SCOPE_ALL, SCOPE_REGION, SCOPE_SELECTION };
+
+    std::uint32_t find = 0;
+    std::uint32_t find_mask = 0;
+    std::uint32_t replace = 0;
+    std::uint32_t replace_mask = 0;
+    scope_t scope = SCOPE_ALL;
+    rect_t region = {}; // In tiles, for 'SCOPE_REGION'.
+};
+
+struct tile_replace_result_t
+{
+    std::vector<undo_tiles_t> undos; // One per changed level, for that level's own history.
+    std::size_t matches = 0;
+    unsigned levels = 0; // How many levels had matches.
+    std::vector<level_model_t*> matched; // Those levels.
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // model ///////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -469,6 +725,7 @@ struct model_t
 
     bool show_collisions = false;
     bool show_grid = true;
+    bool software_render = true; // Compose levels into one RGB buffer, rather than drawing tile by tile.
 
     wxStatusBar* status_bar = nullptr;
 
@@ -484,20 +741,30 @@ struct model_t
     object_t object_picker = {};
 
     std::deque<chr_file_t> chr_files;
+    bool poll_chr();
 
     unsigned metatile_size = 0;
     unsigned collision_scale() const { return std::max<unsigned>(metatile_size, 1); }
     dimen_t collision_div(dimen_t d) const { return vec_div(d + dimen_t{ collision_scale() - 1, collision_scale() - 1 }, collision_scale()); }
     std::filesystem::path collision_path;
+    wxImage collision_image; // Decoded from 'collision_path', kept to rescale from.
     std::vector<bitmap_t> collision_bitmaps;
     std::vector<wxBitmap> collision_wx_bitmaps;
+    std::uint64_t collision_generation = 0; // Bumped whenever the collision bitmaps change.
+
+    void load_collisions(); // Reads 'collision_path' from disk.
+    void rescale_collisions(); // Re-slices the cached image at 'collision_scale'.
 
     palette_array_t palette_array(unsigned palette_index = 0);
 
+    // Runs across 'levels' on the worker pool.
+    tile_replace_result_t replace_tiles(tile_replace_t const& replace);
+
     // Undo operations:
     undo_t undo(undo_t const& undo) { modify(); return std::visit(*this, undo); }
     undo_t operator()(std::monostate const& m) { return m; }
     undo_t operator()(undo_tiles_t const& undo);
+    undo_t operator()(undo_tile_spans_t const& undo);
     undo_t operator()(undo_palette_num_t const& undo);
     undo_t operator()(undo_level_dimen_t const& undo);
     undo_t operator()(undo_new_object_t const& undo);
@@ -529,6 +796,27 @@ struct undo_history_t
     void push(undo_t const& undo); 
     bool empty(undo_type_t U) const { return history[U].empty(); }
 
+    // Calls 'fn' on every recorded tile of 'layer', for edits that renumber tiles outside of the history.
+    template<typename Fn>
+    void for_each_tile(tile_layer_t const* layer, Fn const& fn)
+    {
+        for(auto& records : history)
+        {
+            for(undo_t& undo : records)
+            {
+                if(auto* tiles = std::get_if<undo_tiles_t>(&undo); tiles && tiles->layer == layer)
+                    for(std::uint32_t& t : tiles->tiles)
+                        fn(t);
+                else if(auto* spans = std::get_if<undo_tile_spans_t>(&undo); spans && spans->layer == layer)
+                    for(std::uint32_t& t : spans->tiles)
+                        fn(t);
+                else if(auto* dimen = std::get_if<undo_level_dimen_t>(&undo); dimen && dimen->layer == layer)
+                    for(std::uint32_t& t : dimen->tiles)
+                        fn(t);
+            }
+        }
+    }
+
     template<typename T>
     bool on_top() const
     {
@@ -1,5 +1,7 @@
 #include "palette.hpp"
 
+#include <memory>
+
 static char int_to_char(int i)
 {
     switch(i)
@@ -57,6 +59,93 @@ void draw_color_tile(render_t& gc, unsigned color, coord_t at)
 template void draw_color_tile<true>(render_t& gc, unsigned color, coord_t at);
 template void draw_color_tile<false>(render_t& gc, unsigned color, coord_t at);
 
+////////////////////////////////////////////////////////////////////////////////
+// glyph_cache_t //////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+void glyph_cache_t::validate(wxWindow const& window, int new_scale)
+{
+    double const new_content_scale = window.GetContentScaleFactor();
+    if(new_scale == scale && new_content_scale == content_scale)
+        return;
+    scale = new_scale;
+    content_scale = new_content_scale;
+    swatches.clear();
+    texts.clear();
+}
+
+template<typename Fn>
+glyph_cache_t::entry_t glyph_cache_t::prerender(render_t& gc, wxSize logical, wxColour const& background, Fn const& draw) const
+{
+    wxSize const size(logical.x * scale, logical.y * scale);
+    wxBitmap bitmap(size);
+    {
+        wxMemoryDC mdc(bitmap);
+        mdc.SetBackground(wxBrush(background));
+        mdc.Clear();
+#if GC_RENDER
+        std::unique_ptr<wxGraphicsContext> mgc(get_renderer()->CreateContext(mdc));
+        if(mgc)
+        {
+            mgc->Scale(scale, scale);
+            draw(*mgc);
+        }
+#else
+        mdc.SetUserScale(scale, scale);
+        draw(mdc);
+#endif
+    }
+#if GC_RENDER
+    return { gc.CreateBitmap(bitmap), size };
+#else
+    return { bitmap, size };
+#endif
+}
+
+glyph_cache_t::entry_t const& glyph_cache_t::swatch(render_t& gc, unsigned color)
+{
+    auto const it = swatches.find(color);
+    if(it != swatches.end())
+        return it->second;
+
+    entry_t entry = prerender(gc, wxSize(color_tile_size, color_tile_size), *wxBLACK, [&](render_t& mgc)
+    {
+        draw_color_tile<true>(mgc, color, { 0, 0 });
+    });
+    return swatches.emplace(color, std::move(entry)).first->second;
+}
+
+glyph_cache_t::entry_t const& glyph_cache_t::text(render_t& gc, wxString const& string, wxColour const& background)
+{
+    std::string const key = string.ToStdString();
+    auto const it = texts.find(key);
+    if(it != texts.end())
+        return it->second;
+
+    wxFont const font = wxFont(wxFontInfo(4));
+    int w, h;
+    set_font(gc, font, *wxBLACK);
+    text_extent(gc, string, &w, &h);
+
+    entry_t entry = prerender(gc, wxSize(w + 1, h + 1), background, [&](render_t& mgc)
+    {
+        set_font(mgc, font, *wxBLACK);
+        mgc.DrawText(string, 0, 0);
+    });
+    return texts.emplace(key, std::move(entry)).first->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// color_picker_t /////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+void color_picker_t::draw_tile(render_t& gc, unsigned color, coord_t at)
+{
+    glyphs.validate(*this, scale);
+    auto const& entry = glyphs.swatch(gc, color);
+    draw_prescaled(gc, entry.bitmap, entry.size, at.x, at.y, scale);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // palette_canvas_t ///////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -65,8 +154,10 @@ void palette_canvas_t::draw_tiles(render_t& gc)
 {
     canvas_box_t::draw_tiles(gc);
 
+    glyphs.validate(*this, scale);
+    wxColour const background = GetBackgroundColour();
+
     gc.SetPen(wxPen(wxColor(255, 0, 255), 0, wxPENSTYLE_DOT));
-    set_font(gc, wxFont(wxFontInfo(4)), *wxBLACK);
 
     auto const vline = [&](unsigned x, wxString text, bool line = true, int text_offset = -32)
     {
@@ -74,7 +165,8 @@ void palette_canvas_t::draw_tiles(render_t& gc)
         unsigned sy = margin().h + model.palette.color_layer.num * color_tile_size;
         if(line)
             draw_line(gc, sx, margin().h/2, sx, sy + margin().h/2);
-        gc.DrawText(text, sx + text_offset, margin().h / 2);
+        auto const& entry = glyphs.text(gc, text, background);
+        draw_prescaled(gc, entry.bitmap, entry.size, int(sx) + text_offset, margin().h / 2, scale);
     };
     vline(3,  "BG 0");
     vline(6,  "BG 1");
@@ -90,9 +182,8 @@ void palette_canvas_t::draw_tiles(render_t& gc)
     {
         wxString string;
         string << i;
-        int w, h;
-        text_extent(gc, string, &w, &h);
-        gc.DrawText(string, margin().w - w - 2, margin().h + 5 + i*16);
+        auto const& entry = glyphs.text(gc, string, background);
+        draw_prescaled(gc, entry.bitmap, entry.size, margin().w - (entry.size.x / scale - 1) - 2, margin().h + 5 + i*16, scale);
     }
 }
 
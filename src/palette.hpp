@@ -1,6 +1,9 @@
 #ifndef PALETTE_HPP
 #define PALETTE_HPP
 
+#include <string>
+#include <unordered_map>
+
 #include <wx/wx.h>
 #include <wx/grid.h>
 #include <wx/spinctrl.h>
@@ -17,6 +20,31 @@ constexpr unsigned color_tile_size = 16;
 template<bool ShowNum>
 void draw_color_tile(render_t& gc, unsigned color, coord_t at);
 
+// Pre-rendered swatches and labels, so that repaints don't create fonts or shape text.
+// Entries are rendered at the view's zoom, and dropped when the zoom or DPI changes.
+class glyph_cache_t
+{
+public:
+    struct entry_t
+    {
+        bitmap_t bitmap;
+        wxSize size; // In device pixels.
+    };
+
+    void validate(wxWindow const& window, int scale);
+    entry_t const& swatch(render_t& gc, unsigned color);
+    entry_t const& text(render_t& gc, wxString const& string, wxColour const& background);
+
+private:
+    template<typename Fn>
+    entry_t prerender(render_t& gc, wxSize logical, wxColour const& background, Fn const& draw) const;
+
+    int scale = 0;
+    double content_scale = 0;
+    std::unordered_map<unsigned, entry_t> swatches;
+    std::unordered_map<std::string, entry_t> texts;
+};
+
 class color_picker_t : public selector_box_t
 {
 public:
@@ -25,8 +53,13 @@ public:
     { resize(); }
 
 protected:
-    virtual void draw_tile(render_t& gc, unsigned color, coord_t at) override { draw_color_tile<true>(gc, color, at); }
+    virtual void draw_tile(render_t& gc, unsigned color, coord_t at) override;
     virtual tile_model_t& tiles() const { return model.palette; }
+
+    // The swatches never change, so they're drawn once per size and zoom.
+    virtual bool use_backbuffer() const override { return true; }
+
+    glyph_cache_t glyphs;
 };
 
 class palette_canvas_t : public canvas_box_t
@@ -45,6 +78,8 @@ private:
     virtual void draw_tile(render_t& gc, unsigned color, coord_t at) override { draw_color_tile<false>(gc, color, at); }
     virtual void draw_tiles(render_t& gc) override;
     virtual int tile_code(coord_t c) override { return c.x; }
+
+    glyph_cache_t glyphs;
 };
 
 class palette_editor_t : public editor_t
@@ -0,0 +1,81 @@
+#ifndef PERF_HPP
+#define PERF_HPP
+
+// Lightweight timing and counting for the paint-performance overlay.
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <utility>
+
+using perf_clock_t = std::chrono::steady_clock;
+
+inline double ms_since(perf_clock_t::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(perf_clock_t::now() - start).count();
+}
+
+// Adds the time spent in its scope to 'ms'.
+class scoped_timer_t
+{
+public:
+    explicit scoped_timer_t(double& ms) : ms(ms), start(perf_clock_t::now()) {}
+    ~scoped_timer_t() { ms += ms_since(start); }
+
+    scoped_timer_t(scoped_timer_t const&) = delete;
+    scoped_timer_t& operator=(scoped_timer_t const&) = delete;
+private:
+    double& ms;
+    perf_clock_t::time_point start;
+};
+
+// What a single paint did. Draw paths add to the counts as they go.
+struct paint_counts_t
+{
+    double paint_ms = 0;
+    double backbuffer_ms = 0;
+    unsigned tiles = 0;
+    unsigned rects = 0;
+    unsigned objects = 0;
+};
+
+// Keeps the paints of the last second.
+class paint_stats_t
+{
+public:
+    void record(paint_counts_t const& counts)
+    {
+        auto const now = perf_clock_t::now();
+        m_last = counts;
+        m_window.emplace_back(now, counts.paint_ms);
+        while(m_window.front().first < now - std::chrono::seconds(1))
+            m_window.pop_front();
+    }
+
+    paint_counts_t const& last() const { return m_last; }
+
+    // These skip the paints older than a second, as 'record' isn't called once painting stops.
+    unsigned per_second() const { return m_window.end() - fresh(); }
+
+    double average_ms() const
+    {
+        auto const begin = fresh();
+        double sum = 0;
+        for(auto it = begin; it != m_window.end(); ++it)
+            sum += it->second;
+        return begin == m_window.end() ? 0.0 : sum / (m_window.end() - begin);
+    }
+
+private:
+    paint_counts_t m_last = {};
+    using window_t = std::deque<std::pair<perf_clock_t::time_point, double>>;
+    window_t m_window;
+
+    window_t::const_iterator fresh() const
+    {
+        auto const start = perf_clock_t::now() - std::chrono::seconds(1);
+        return std::partition_point(m_window.begin(), m_window.end(), [&](auto const& pair) { return pair.first < start; });
+    }
+};
+
+#endif
@@ -6,6 +6,7 @@ enum tool_t
     TOOL_STAMP,
     TOOL_DROPPER,
     TOOL_SELECT,
+    TOOL_BUCKET,
     NUM_TOOLS,
 };
 
@@ -0,0 +1,63 @@
+#include "worker.hpp"
+
+#include <algorithm>
+
+#include <wx/app.h>
+
+worker_pool_t::worker_pool_t(unsigned num_threads)
+{
+    for(unsigned i = 0; i < num_threads; ++i)
+        threads.emplace_back(&worker_pool_t::run, this);
+}
+
+worker_pool_t::~worker_pool_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+
+    for(std::thread& thread : threads)
+        thread.join();
+}
+
+void worker_pool_t::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    cv.notify_one();
+}
+
+void worker_pool_t::run()
+{
+    while(true)
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]{ return stop || !jobs.empty(); });
+            if(stop)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        try
+        {
+            job();
+        }
+        catch(...) {}
+
+        wxWakeUpIdle();
+    }
+}
+
+worker_pool_t& workers()
+{
+    static worker_pool_t pool(std::max<int>(1, int(std::thread::hardware_concurrency()) - 1));
+    return pool;
+}
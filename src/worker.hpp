@@ -0,0 +1,134 @@
+#ifndef WORKER_HPP
+#define WORKER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A fixed set of background threads that run queued jobs.
+// After each job finishes, the UI is woken up so that idle handlers can poll for results.
+class worker_pool_t
+{
+public:
+    explicit worker_pool_t(unsigned num_threads);
+    ~worker_pool_t();
+
+    worker_pool_t(worker_pool_t const&) = delete;
+    worker_pool_t& operator=(worker_pool_t const&) = delete;
+
+    void submit(std::function<void()> job);
+    unsigned size() const { return threads.size(); }
+
+private:
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> threads;
+    bool stop = false;
+};
+
+// The shared pool used by the editor.
+worker_pool_t& workers();
+
+// Calls 'fn(i)' for each 'i' in [begin, end), splitting the range across the shared pool.
+// The calling thread takes chunks too, so this is safe to use from inside a job.
+template<typename Fn>
+void parallel_for(unsigned begin, unsigned end, Fn const& fn)
+{
+    if(begin >= end)
+        return;
+
+    unsigned const n = end - begin;
+    unsigned const helpers = std::min(workers().size(), n - 1);
+    if(helpers == 0)
+    {
+        for(unsigned i = begin; i < end; ++i)
+            fn(i);
+        return;
+    }
+
+    struct state_t
+    {
+        std::atomic<unsigned> next = 0;
+        unsigned done = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    auto state = std::make_shared<state_t>();
+    unsigned const chunks = std::min(n, (helpers + 1) * 4);
+
+    // 'fn' is only touched after claiming a chunk, and the caller waits for every chunk,
+    // so helpers that start late never see a dangling reference.
+    auto const work = [state, chunks, begin, n, &fn]()
+    {
+        unsigned chunk;
+        while((chunk = state->next.fetch_add(1)) < chunks)
+        {
+            std::exception_ptr error;
+            try
+            {
+                unsigned const lo = begin + std::uint64_t(n) * chunk / chunks;
+                unsigned const hi = begin + std::uint64_t(n) * (chunk + 1) / chunks;
+                for(unsigned i = lo; i < hi; ++i)
+                    fn(i);
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if(error && !state->error)
+                state->error = error;
+            if(++state->done == chunks)
+                state->cv.notify_all();
+        }
+    };
+
+    for(unsigned i = 0; i < helpers; ++i)
+        workers().submit(work);
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&]{ return state->done == chunks; });
+    if(state->error)
+        std::rethrow_exception(state->error);
+}
+
+// A slot through which a background job hands its result to the UI thread.
+template<typename T>
+class pending_t
+{
+public:
+    void post(T&& value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = std::move(value);
+    }
+
+    std::optional<T> take()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::exchange(result, std::nullopt);
+    }
+
+private:
+    std::mutex mutex;
+    std::optional<T> result;
+};
+
+#endif